@@ -0,0 +1,161 @@
+// Microbenchmark du découpage des en-têtes : ancienne méthode (std::string::find, avec
+// re-scan depuis 0 à chaque paquet) contre ByteScan (scalaire, SSE2, AVX2), noyau seul
+// puis HttpRequestParser complet. Usage : ./header_bench [itérations]
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+#include <time.h>
+#include "http/ByteScan.hpp"
+#include "http/BufferChain.hpp"
+#include "http/HttpRequest.hpp"
+
+static const char* const BROWSER_REQUEST =
+    "GET /dashboard/projects?id=4512&tab=activity HTTP/1.1\r\n"
+    "Host: intranet.example.com\r\n"
+    "Connection: keep-alive\r\n"
+    "sec-ch-ua-mobile: ?0\r\n"
+    "sec-ch-ua-platform: \"Linux\"\r\n"
+    "Upgrade-Insecure-Requests: 1\r\n"
+    "User-Agent: Mozilla/5.0 (X11; Linux x86_64) AppleWebKit/537.36 (KHTML, like Gecko) Chrome/124.0.0.0 Safari/537.36\r\n"
+    "Accept: text/html,application/xhtml+xml,application/xml;q=0.9,image/avif,image/webp,image/apng,*/*;q=0.8\r\n"
+    "Sec-Fetch-Site: same-origin\r\n"
+    "Sec-Fetch-Mode: navigate\r\n"
+    "Sec-Fetch-User: ?1\r\n"
+    "Sec-Fetch-Dest: document\r\n"
+    "Accept-Encoding: gzip, deflate, br, zstd\r\n"
+    "Accept-Language: fr-FR,fr;q=0.9,en-US;q=0.8,en;q=0.7\r\n"
+    "Cookie: session_id=8f14e45fceea167a5a36dedd4bea2543; theme=dark; lang=fr; "
+    "_ga=GA1.1.1234567890.1700000000; csrftoken=Zx9vQ2mN7pL4kT1rW8yB3cF6hJ0sD5gA\r\n"
+    "\r\n";
+
+#define PACKET_SIZE 128   // Tête reçue en plusieurs lectures, comme sur un lien lent
+
+static double nowNs() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+static volatile size_t g_sink; // Empêche l'élimination des boucles
+
+// Ancienne méthode : à chaque paquet, recherche de \r\n\r\n depuis le début, puis
+// découpage ligne par ligne avec find("\r\n") et find(':')
+static size_t scanStringFind(const std::string& request) {
+    std::string buffer;
+    size_t headerEnd = std::string::npos;
+    for (size_t off = 0; off < request.size() && headerEnd == std::string::npos; off += PACKET_SIZE) {
+        buffer.append(request, off, PACKET_SIZE);
+        headerEnd = buffer.find("\r\n\r\n");
+    }
+    size_t fields = 0;
+    size_t pos = buffer.find("\r\n") + 2;
+    while (pos < headerEnd) {
+        size_t lineEnd = buffer.find("\r\n", pos);
+        size_t colon = buffer.find(':', pos);
+        if (colon != std::string::npos && colon < lineEnd) {
+            fields += colon - pos;
+        }
+        pos = lineEnd + 2;
+    }
+    return fields;
+}
+
+// Noyau seul : un passage qui relève les \r et le premier ':' de chaque ligne
+static size_t scanKernel(const std::string& request) {
+    const char* p = request.data();
+    const char* end = p + request.size();
+    const char* lineStart = p;
+    const char* colon = NULL;
+    size_t fields = 0;
+    while (true) {
+        const char* hit = ByteScan::findAny(p, end, '\r', ':');
+        if (hit == end || hit + 1 >= end) {
+            break;
+        }
+        p = hit + 1;
+        if (*hit == ':') {
+            if (!colon) {
+                colon = hit;
+            }
+            continue;
+        }
+        if (hit[1] != '\n') {
+            continue;
+        }
+        if (hit == lineStart) {
+            break;
+        }
+        if (colon) {
+            fields += colon - lineStart;
+        }
+        lineStart = hit + 2;
+        colon = NULL;
+    }
+    return fields;
+}
+
+// Analyseur complet, alimenté paquet par paquet comme par readFrom. La chaîne,
+// l'analyseur et la requête servent d'une itération à l'autre, comme sur une
+// connexion keep-alive : seul le travail par requête est mesuré.
+static size_t scanParser(const std::string& request, BufferChain& chain, HttpRequestParser& parser,
+                         HttpRequest& out) {
+    for (size_t off = 0; off < request.size(); off += PACKET_SIZE) {
+        size_t len = (request.size() - off < PACKET_SIZE) ? request.size() - off : PACKET_SIZE;
+        chain.append(request.data() + off, len);
+        HttpRequestParser::Status status = parser.advance(chain);
+        if (status == HttpRequestParser::PARSE_HEAD_READY) {
+            status = parser.advance(chain);
+        }
+        if (status != HttpRequestParser::PARSE_INCOMPLETE) {
+            break;
+        }
+    }
+    parser.take(out);
+    return out.fields.size();
+}
+
+static void report(const char* name, double ns, size_t iterations, size_t bytes) {
+    double perRequest = ns / iterations;
+    printf("  %-28s %8.1f ns/req  %8.0f MB/s\n", name, perRequest, bytes * iterations / (ns / 1e9) / 1e6);
+}
+
+int main(int argc, char** argv) {
+    size_t iterations = (argc > 1) ? strtoul(argv[1], NULL, 10) : 1000000;
+    std::string request(BROWSER_REQUEST);
+    const char* cpuid = ByteScan::implementation();
+    printf("Headers: %zu bytes, %zu iterations, packets of %d bytes, dispatch: %s (cpuid), %s (calibrated)\n",
+           request.size(), iterations, PACKET_SIZE, cpuid, ByteScan::calibrate());
+
+    double start = nowNs();
+    for (size_t i = 0; i < iterations; ++i) {
+        g_sink += scanStringFind(request);
+    }
+    report("std::string::find", nowNs() - start, iterations, request.size());
+
+    const char* impls[] = { "scalar", "sse2", "avx2" };
+    BufferPool pool;
+    BufferChain chain(&pool);
+    HttpRequestParser parser;
+    HttpRequest out;
+    for (size_t k = 0; k < sizeof(impls) / sizeof(impls[0]); ++k) {
+        if (!ByteScan::select(impls[k])) {
+            printf("  %s: not supported by this CPU\n", impls[k]);
+            continue;
+        }
+        std::string label = std::string("kernel ") + impls[k];
+        start = nowNs();
+        for (size_t i = 0; i < iterations; ++i) {
+            g_sink += scanKernel(request);
+        }
+        report(label.c_str(), nowNs() - start, iterations, request.size());
+
+        label = std::string("HttpRequestParser ") + impls[k];
+        start = nowNs();
+        for (size_t i = 0; i < iterations; ++i) {
+            g_sink += scanParser(request, chain, parser, out);
+        }
+        report(label.c_str(), nowNs() - start, iterations, request.size());
+    }
+    return 0;
+}
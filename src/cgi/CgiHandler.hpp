@@ -3,6 +3,7 @@
 
 #include <string>
 #include <map>
+#include <vector>
 #include <unistd.h>
 #include <cstring>
 #include <ctime>
@@ -11,21 +12,59 @@
 #include <signal.h>
 #include <fcntl.h>
 #include <ctype.h>
+#include "../http/SharedBuffer.hpp"
+
+// Tranche d'un fichier précédée de son texte (en-têtes d'une partie multipart/byteranges)
+struct FileSegment {
+    std::string prefix;
+    off_t offset;
+    off_t end;          // offset == end : texte seul (délimiteur final)
+};
 
 // Structure for client response buffering
+// Un corps de fichier statique n'est pas copié dans data : il part de fileFd par
+// sendfile, de fileOffset à fileEnd, une fois data (les en-têtes) envoyé. Une réponse
+// du cache suit data depuis shared (sharedLength octets à partir de sharedOffset), sans
+// copie non plus.
+// Une réponse multi-intervalles enchaîne ensuite segments : chaque prefix remplace data
+// et sa tranche part du même fileFd.
 struct ResponseBuffer {
     std::string data;
     size_t sent;
     bool isComplete;
+    bool keepAlive;     // Garder la connexion ouverte une fois la réponse envoyée
+    bool deferred;      // Réponse produite plus tard (CGI) : réserve sa place dans la file
+    int fileFd;         // -1 : tout le corps est dans data
+    off_t fileOffset;   // Prochain octet du fichier à envoyer
+    off_t fileEnd;
+    std::vector<FileSegment> segments;
+    size_t nextSegment;
+    SharedBuffer* shared;   // Référence possédée ; NULL sans réponse du cache
+    size_t sharedOffset;
+    size_t sharedLength;
     
-    ResponseBuffer() : sent(0), isComplete(false) {
+    ResponseBuffer() : sent(0), isComplete(false), keepAlive(false), deferred(false),
+                       fileFd(-1), fileOffset(0), fileEnd(0), nextSegment(0), shared(NULL),
+                       sharedOffset(0), sharedLength(0) {
         // Pre-allocate reasonable initial capacity - avoid excessive memory usage
         data.reserve(8192); // 8KB initial capacity - more reasonable for most responses
     }
     
     ~ResponseBuffer() {
-        // No resources to clean up
+        if (fileFd != -1) {
+            close(fileFd);
+        }
+        if (shared) {
+            shared->release();
+        }
     }
+    
+    size_t length() const { return data.length() + sharedLength; } // Hors corps de fichier
+    bool hasFileBody() const { return fileFd != -1 && (fileOffset < fileEnd || nextSegment < segments.size()); }
+
+private:
+    ResponseBuffer(const ResponseBuffer&);
+    ResponseBuffer& operator=(const ResponseBuffer&);
 };
 
 // Structure pour les processus CGI
@@ -42,14 +81,21 @@ struct CgiProcess {
     int stdin_fd;
     
     // Track if process has finished
-    bool finished;
-    int exit_status;
+    bool finished;      // Processus récupéré (pidfd) : exit_status est connu
+    bool outputDone;    // EOF lu sur stdout
+    int exit_status;    // -1 : tué par un signal
+    int pidfd;
     
     // Store server config for error handling
     const void* server_config; // Pointer to Server object
     
+    // Emplacement réservé dans la file de réponses du client (ordre du pipelining)
+    ResponseBuffer* slot;
+    
     CgiProcess() : pipe_fd(-1), pid(-1), start_time(0), cgiHandler(NULL), 
-                   input_written(0), stdin_fd(-1), finished(false), exit_status(0), server_config(NULL) {}
+                   input_written(0), stdin_fd(-1), finished(false), outputDone(false), exit_status(0), pidfd(-1),
+                   server_config(NULL),
+                   slot(NULL) {}
 };
 
 #endif
\ No newline at end of file
@@ -0,0 +1,25 @@
+#include"GlobalConfig.hpp"
+
+GlobalConfig::GlobalConfig() :
+    worker_threads(1),
+    edge_triggered(false),
+    worker_connections(1024),
+    max_connections(0),
+    open_file_cache_size(16 * 1024 * 1024),
+    open_file_cache_max_file(1024 * 1024),
+    open_file_cache_valid(30)
+{}
+
+GlobalConfig::~GlobalConfig() {}
+
+// max_connections est réparti entre les workers (arrondi au supérieur)
+int GlobalConfig::connectionsPerWorker() const {
+    int limit = worker_connections;
+    if (max_connections > 0) {
+        int share = (max_connections + worker_threads - 1) / worker_threads;
+        if (share < limit) {
+            limit = share;
+        }
+    }
+    return limit;
+}
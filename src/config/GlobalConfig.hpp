@@ -0,0 +1,23 @@
+#ifndef GLOBALCONFIG_HPP
+#define GLOBALCONFIG_HPP
+
+#include <cstddef>
+
+// Directives de premier niveau (hors des blocs server), communes à tout le processus
+class GlobalConfig {
+public:
+    int worker_threads;                         // Nombre de boucles epoll (une par thread)
+    bool edge_triggered;                        // epoll en mode EPOLLET (lecture/écriture jusqu'à EAGAIN)
+    int worker_connections;                     // Clients simultanés max par worker
+    int max_connections;                        // Clients simultanés max pour le processus (0 : pas de limite globale)
+    size_t open_file_cache_size;                // Budget du cache de fichiers statiques par worker (0 : désactivé)
+    size_t open_file_cache_max_file;            // Fichier plus grand : toujours servi par sendfile
+    int open_file_cache_valid;                  // Secondes avant de revérifier une entrée par stat
+
+    int connectionsPerWorker() const;           // Limite effective d'une boucle
+
+    GlobalConfig();
+    ~GlobalConfig();
+};
+
+#endif
@@ -11,7 +11,8 @@ Location::Location() :
     return_url(),
     return_code(0),
     cgi_extensions(),
-    client_max_body_size(0)
+    client_max_body_size(0),
+    client_body_buffer_size(0)
 {}
 
 Location::~Location() {}
@@ -18,6 +18,7 @@ public:
     int return_code;                     // Code de redirection (301, 302, etc.)
     std::map<std::string, std::string> cgi_extensions; // Extensions CGI et leurs interpréteurs
     size_t client_max_body_size;         // Taille max du corps de requête
+    size_t client_body_buffer_size;      // Au-delà, corps écrit dans un fichier temporaire (0 : celui du serveur)
 
     Location();
     ~Location();
@@ -15,6 +15,7 @@
 #include<iostream>
 #include<stdexcept>
 #include<cctype>
+#include<unistd.h>
 
 Parser::Parser() : _currentToken(0) {}
 
@@ -113,6 +114,12 @@ void Parser::parseServers()
 			expectToken("}");
 			_servers.push_back(server);
 		}
+		else if(token == "worker_threads" || token == "edge_triggered"
+			|| token == "worker_connections" || token == "max_connections"
+			|| token == "open_file_cache" || token == "open_file_cache_valid")
+		{
+			parseGlobalDirective(token);
+		}
 		else
 		{
 			throw std::runtime_error("Unexpected token: " + token + ". Expected 'server'");
@@ -120,6 +127,87 @@ void Parser::parseServers()
 	}
 }
 
+void Parser::parseGlobalDirective(const std::string& directive)
+{
+	if(directive == "worker_threads")
+	{
+		std::string value = getNextToken();
+		int threads;
+		if(value == "auto")
+		{
+			// Une boucle par coeur disponible
+			long cores = sysconf(_SC_NPROCESSORS_ONLN);
+			threads = (cores > 0) ? static_cast<int>(cores) : 1;
+		}
+		else
+		{
+			threads = stringToInt(value);
+		}
+		if(threads < 1 || threads > 256)
+		{
+			throw std::runtime_error("Invalid worker_threads value: " + value);
+		}
+		_global.worker_threads = threads;
+	}
+	else if(directive == "edge_triggered")
+	{
+		std::string value = getNextToken();
+		if(value != "on" && value != "off")
+		{
+			throw std::runtime_error("Invalid edge_triggered value: " + value + " (expected on|off)");
+		}
+		_global.edge_triggered = (value == "on");
+	}
+	else if(directive == "worker_connections" || directive == "max_connections")
+	{
+		std::string value = getNextToken();
+		int connections = stringToInt(value);
+		if(connections < 1 || connections > 1048576)
+		{
+			throw std::runtime_error("Invalid " + directive + " value: " + value);
+		}
+		if(directive == "worker_connections")
+			_global.worker_connections = connections;
+		else
+			_global.max_connections = connections;
+	}
+	else if(directive == "open_file_cache")
+	{
+		// open_file_cache <budget> <taille max d'un fichier> | off
+		std::string value = getNextToken();
+		if(value == "off")
+		{
+			_global.open_file_cache_size = 0;
+		}
+		else
+		{
+			size_t budget = stringToSize(value);
+			size_t maxFile = stringToSize(getNextToken());
+			if(maxFile == 0)
+			{
+				throw std::runtime_error("Invalid open_file_cache max file size");
+			}
+			_global.open_file_cache_size = budget;
+			_global.open_file_cache_max_file = maxFile;
+		}
+	}
+	else if(directive == "open_file_cache_valid")
+	{
+		std::string value = getNextToken();
+		int seconds = stringToInt(value);
+		if(seconds < 0)
+		{
+			throw std::runtime_error("Invalid open_file_cache_valid value: " + value);
+		}
+		_global.open_file_cache_valid = seconds;
+	}
+	// Consommer le point-virgule final
+	if(hasMoreTokens() && peekNextToken() == ";")
+	{
+		getNextToken();
+	}
+}
+
 void Parser::parseServer(Server& server)
 {
 	while(hasMoreTokens() && peekNextToken() != "}")
@@ -225,6 +313,46 @@ void Parser::parseDirective(Server& server, Location* location)
 			server.client_max_body_size = maxSize;
 		}
 	}
+	else if(directive == "client_body_buffer_size")
+	{
+		size_t bufferSize = stringToSize(getNextToken());
+		if(location)
+		{
+			location->client_body_buffer_size = bufferSize;
+		}
+		else
+		{
+			server.client_body_buffer_size = bufferSize;
+		}
+	}
+	else if(directive == "client_header_buffer_size")
+	{
+		if(location)
+		{
+			throw std::runtime_error("'client_header_buffer_size' directive not allowed in location context");
+		}
+		size_t bufferSize = stringToSize(getNextToken());
+		if(bufferSize == 0)
+		{
+			throw std::runtime_error("Invalid client_header_buffer_size value");
+		}
+		server.client_header_buffer_size = bufferSize;
+	}
+	else if(directive == "large_client_header_buffers")
+	{
+		if(location)
+		{
+			throw std::runtime_error("'large_client_header_buffers' directive not allowed in location context");
+		}
+		size_t count = stringToSize(getNextToken());
+		size_t bufferSize = stringToSize(getNextToken());
+		if(count == 0 || bufferSize == 0)
+		{
+			throw std::runtime_error("Invalid large_client_header_buffers value");
+		}
+		server.large_client_header_buffers = count;
+		server.large_client_header_buffer_size = bufferSize;
+	}
 	else if(directive == "autoindex")
 	{
 		std::string value = getNextToken();
@@ -303,6 +431,58 @@ void Parser::parseDirective(Server& server, Location* location)
 			server.upload_path = uploadPath;
 		}
 	}
+	else if(directive == "keepalive_timeout")
+	{
+		if(location)
+		{
+			throw std::runtime_error("'keepalive_timeout' directive not allowed in location context");
+		}
+		int timeout = stringToInt(getNextToken());
+		if(timeout < 0)
+		{
+			throw std::runtime_error("Invalid keepalive_timeout value");
+		}
+		server.keepalive_timeout = timeout;
+	}
+	else if(directive == "client_header_timeout" || directive == "client_body_timeout" || directive == "send_timeout")
+	{
+		if(location)
+		{
+			throw std::runtime_error("'" + directive + "' directive not allowed in location context");
+		}
+		int timeout = stringToInt(getNextToken());
+		if(timeout <= 0)
+		{
+			throw std::runtime_error("Invalid " + directive + " value");
+		}
+		if(directive == "client_header_timeout")
+			server.client_header_timeout = timeout;
+		else if(directive == "client_body_timeout")
+			server.client_body_timeout = timeout;
+		else
+			server.send_timeout = timeout;
+	}
+	else if(directive == "min_transfer_rate")
+	{
+		if(location)
+		{
+			throw std::runtime_error("'min_transfer_rate' directive not allowed in location context");
+		}
+		server.min_transfer_rate = stringToSize(getNextToken());
+	}
+	else if(directive == "keepalive_requests")
+	{
+		if(location)
+		{
+			throw std::runtime_error("'keepalive_requests' directive not allowed in location context");
+		}
+		int requests = stringToInt(getNextToken());
+		if(requests < 0)
+		{
+			throw std::runtime_error("Invalid keepalive_requests value");
+		}
+		server.keepalive_requests = requests;
+	}
 	else if(directive == "cgi_extension")
 	{
 		std::string extension = getNextToken();
@@ -462,6 +642,11 @@ const std::vector<Server>& Parser::getServers() const
 	return _servers;
 }
 
+const GlobalConfig& Parser::getGlobalConfig() const
+{
+	return _global;
+}
+
 std::string Parser::trim(const std::string& str)
 {
 	size_t start = str.find_first_not_of(" \t\n\r");
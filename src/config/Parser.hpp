@@ -18,10 +18,12 @@
 #include <fstream>
 #include <sstream>
 #include "Server.hpp"
+#include "GlobalConfig.hpp"
 
 class Parser {
 private:
     std::vector<Server> _servers;
+    GlobalConfig _global;
     std::string _configFile;
     std::vector<std::string> _tokens;
     size_t _currentToken;
@@ -29,6 +31,7 @@ private:
     // Méthodes de parsing
     void tokenize(const std::string& content);
     void parseServers();
+    void parseGlobalDirective(const std::string& directive);
     void parseServer(Server& server);
     void parseLocation(Server& server);
     void parseDirective(Server& server, Location* location = NULL);
@@ -54,6 +57,7 @@ public:
     
     void parseConfigFile(const std::string& configFile);
     const std::vector<Server>& getServers() const;
+    const GlobalConfig& getGlobalConfig() const;
     
     // Méthodes utilitaires
     static std::string trim(const std::string& str);
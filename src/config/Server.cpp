@@ -25,11 +25,21 @@ Server::Server() :
     index(),
     error_pages(),
     client_max_body_size(0),
+    client_body_buffer_size(16384),
+    client_header_buffer_size(1024),
+    large_client_header_buffers(4),
+    large_client_header_buffer_size(8192),
     locations(),
     cgi_extensions(),
     autoindex(false),
     allow_methods(),
-    upload_path()
+    upload_path(),
+    keepalive_timeout(75),
+    keepalive_requests(100),
+    client_header_timeout(60),
+    client_body_timeout(60),
+    send_timeout(60),
+    min_transfer_rate(0)
 {
 	// Ne pas ajouter de port par défaut ici - sera fait après le parsing si nécessaire
 }
@@ -14,11 +14,21 @@ public:
     std::string index;                          // Fichier index par défaut
     std::map<int, std::string> error_pages;     // Pages d'erreur personnalisées
     size_t client_max_body_size;                // Taille max du corps de requête
+    size_t client_body_buffer_size;             // Au-delà, corps écrit dans un fichier temporaire
+    size_t client_header_buffer_size;           // Fenêtre de lecture initiale d'une tête de requête
+    size_t large_client_header_buffers;         // Nombre de grands tampons : la tête entière doit y tenir
+    size_t large_client_header_buffer_size;     // Taille d'un grand tampon : limite d'une ligne de tête
     std::vector<Location> locations;            // Locations configurées
     std::map<std::string, std::string> cgi_extensions; // Extensions CGI globales
     bool autoindex;                             // Autoindex global
     std::vector<std::string> allow_methods; // Méthodes HTTP autorisées
     std::string upload_path;                    // Chemin d'upload par défaut
+    int keepalive_timeout;                      // Délai d'inactivité keep-alive (secondes, 0 = désactivé)
+    int keepalive_requests;                     // Nombre max de requêtes par connexion persistante
+    int client_header_timeout;                  // Secondes pour recevoir la tête entière
+    int client_body_timeout;                    // Secondes sans recevoir d'octet de corps
+    int send_timeout;                           // Secondes sans pouvoir envoyer d'octet de réponse
+    size_t min_transfer_rate;                   // Débit minimal (octets/s) du corps et de l'envoi (0 = désactivé)
     
     Server();
     ~Server();
@@ -1,15 +1,20 @@
 #include "EpollClasse.hpp"
 #include "TimeoutManager.hpp"
+#include "ProcessControl.hpp"
 #include <cstdlib>
 #include <fstream>
 #include <cstring>
+#include <strings.h>   // strcasecmp
 #include <sstream>
 #include <iomanip>
 #include <sys/stat.h>
 #include <sys/wait.h>
 #include <signal.h>
+#include <sys/syscall.h>  // SYS_pidfd_open
 #include <netinet/tcp.h>  // For TCP_NODELAY
 #include <sys/socket.h>   // For socket options
+#include <sys/sendfile.h>
+#include <sys/uio.h>
 #include <algorithm> // Ensure std::find is available
 #include <utility>   // for std::move
 #include "../utils/Logger.hpp"
@@ -17,6 +22,9 @@
 #include "../routes/RedirectionHandler.hpp"
 #include "../utils/Utils.hpp"
 #include "../http/RequestBufferManager.hpp"
+#include "../http/MultipartUpload.hpp"
+#include "../http/ByteRange.hpp"
+#include "../http/HttpValidators.hpp"
 #include "../config/ServerNameHandler.hpp"
 #include"../cgi/CgiHandler.hpp"
 
@@ -24,11 +32,21 @@
 #include <fnmatch.h>     // for fnmatch
 #include <algorithm>     // for std::count
 
+#ifndef SYS_pidfd_open
+# define SYS_pidfd_open 434 // Même numéro sur toutes les architectures (Linux >= 5.3)
+#endif
+
 #define BUFFER_SIZE 65536  // Augmenté à 64KB pour éviter les buffer overflow
 #define MAX_BUFFER_SIZE 10485760  // 10MB max pour les très gros fichiers
 
-// Déclaration de l'instance globale du RequestBufferManager
-RequestBufferManager _bufferManager;
+// Rattache temporairement les réponses émises à un slot de la file du client (ex: sortie CGI)
+struct SlotScope {
+    ResponseBuffer*& current;
+    ResponseBuffer* saved;
+
+    SlotScope(ResponseBuffer*& cur, ResponseBuffer* slot) : current(cur), saved(cur) { current = slot; }
+    ~SlotScope() { current = saved; }
+};
 
 // Fonction utilitaire pour convertir size_t en string (compatible C++98)
 static std::string sizeToString(size_t value)
@@ -80,9 +98,14 @@ static std::string smartJoinRootAndPath(const std::string& root, const std::stri
 }
 
 // Constructeur
-EpollClasse::EpollClasse() : _serverConfigs(NULL), timeoutManager(60) // Augmenté à 60 secondes pour les très gros corps
+EpollClasse::EpollClasse() : _serverConfigs(NULL), timeoutManager(),
+                             _cgiCount(0), _currentSlot(NULL), _processingFd(-1),
+                             _edgeTriggered(false), _pidfdSupported(false),
+                             _maxClients(1024), _clientCount(0), _listenersPaused(false), _listenersPausedUntil(0),
+                             _reserveFd(-1),
+                             _draining(false), _dateSecond(0), _boundarySerial(0)
 {
-    _epoll_fd = epoll_create1(0);
+    _epoll_fd = epoll_create1(EPOLL_CLOEXEC);
     if (_epoll_fd == -1)
     {
         Logger::logMsg(RED, CONSOLE_OUTPUT, "Epoll creation failed");
@@ -90,33 +113,173 @@ EpollClasse::EpollClasse() : _serverConfigs(NULL), timeoutManager(60) // Augment
     }
     _biggest_fd = 0;
     
-    // Set up signal handling for child processes to avoid zombies
-    signal(SIGCHLD, SIG_IGN); // Automatically reap child processes
+    // Fin des CGI notifiée par pidfd : SIGCHLD garde son action par défaut pour que
+    // waitpid() obtienne le code de sortie. Sans pidfd (noyau < 5.3), reaping automatique.
+    int probe = static_cast<int>(syscall(SYS_pidfd_open, getpid(), 0));
+    _pidfdSupported = (probe != -1);
+    if (_pidfdSupported) {
+        close(probe);
+        signal(SIGCHLD, SIG_DFL);
+    } else {
+        signal(SIGCHLD, SIG_IGN); // Automatically reap child processes
+    }
     signal(SIGPIPE, SIG_IGN); // Ignore broken pipe signals
+    
+    _reserveFd = open("/dev/null", O_RDONLY | O_CLOEXEC);
 }
 
 // Destructeur
 EpollClasse::~EpollClasse()
 {
-    // Clean up any remaining CGI processes
-    for (std::map<int, CgiProcess*>::iterator it = _cgiProcesses.begin(); it != _cgiProcesses.end(); ++it) {
-        CgiProcess* process = it->second;
-        delete process;
-    }
-    _cgiProcesses.clear();
-    _cgiToClient.clear();
-    
-    // Clean up response buffers
-    for (std::map<int, ResponseBuffer*>::iterator it = _responseBuffers.begin(); it != _responseBuffers.end(); ++it) {
-        delete it->second;
+    // Clean up remaining CGI processes and response buffers
+    for (size_t fd = 0; fd < _fdTable.size(); ++fd) {
+        FdContext* ctx = _fdTable[fd];
+        if (!ctx) {
+            continue;
+        }
+        if (ctx->role == FD_CGI_OUTPUT) {
+            delete ctx->cgi;
+        }
+        for (std::deque<ResponseBuffer*>::iterator slotIt = ctx->responses.begin(); slotIt != ctx->responses.end(); ++slotIt) {
+            delete *slotIt;
+        }
+        delete ctx;
     }
-    _responseBuffers.clear();
-    _clientsInEpollOut.clear();
+    _fdTable.clear();
     
     if (_epoll_fd != -1)
     {
         close(_epoll_fd);
     }
+    if (_reserveFd != -1)
+    {
+        close(_reserveFd);
+    }
+}
+
+// A appeler avant setupServers : le mode s'applique à tous les fd enregistrés ensuite
+void EpollClasse::setEdgeTriggered(bool enabled)
+{
+    _edgeTriggered = enabled;
+}
+
+// Clients simultanés max pour cette boucle (worker_connections / max_connections)
+void EpollClasse::setConnectionLimit(int maxClients)
+{
+    _maxClients = (maxClients > 0) ? static_cast<size_t>(maxClients) : 1;
+}
+
+// A appeler après setupServers (l'instance epoll existe) : le fd inotify rejoint la boucle
+void EpollClasse::setFileCache(size_t budget, size_t maxFileSize, int validSeconds)
+{
+    _fileCache.configure(budget, maxFileSize, validSeconds);
+    if (_fileCache.inotifyFd() != -1) {
+        epoll_event event;
+        event.events = eventMask(EPOLLIN);
+        event.data.ptr = acquireContext(_fileCache.inotifyFd(), FD_FILE_CACHE);
+        addToEpoll(_fileCache.inotifyFd(), event);
+    }
+}
+
+// Boucle pleine ou plus de fd : les listeners ne sont plus surveillés, les connexions
+// attendent dans la file du noyau au lieu de réveiller la boucle en permanence
+void EpollClasse::pauseListeners()
+{
+    if (_listenersPaused) {
+        return;
+    }
+    for (std::vector<ServerConfig>::iterator it = _servers.begin(); it != _servers.end(); ++it) {
+        epoll_event event;
+        event.events = 0;
+        event.data.ptr = getContext(it->getFd());
+        epoll_ctl(_epoll_fd, EPOLL_CTL_MOD, it->getFd(), &event);
+    }
+    _listenersPaused = true;
+    Logger::logMsg(YELLOW, CONSOLE_OUTPUT, "Connection limit reached (%zu clients), accept paused", _clientCount);
+}
+
+// EPOLL_CTL_MOD réévalue l'état : une file non vide est signalée aussitôt (y compris en EPOLLET)
+void EpollClasse::resumeListeners()
+{
+    if (!_listenersPaused || _draining) {
+        return;
+    }
+    for (std::vector<ServerConfig>::iterator it = _servers.begin(); it != _servers.end(); ++it) {
+        epoll_event event;
+        event.events = eventMask(EPOLLIN);
+        event.data.ptr = getContext(it->getFd());
+        epoll_ctl(_epoll_fd, EPOLL_CTL_MOD, it->getFd(), &event);
+    }
+    _listenersPaused = false;
+    _listenersPausedUntil = 0;
+    Logger::logMsg(GREEN, CONSOLE_OUTPUT, "Accept resumed (%zu clients)", _clientCount);
+}
+
+// EMFILE/ENFILE : libérer le fd de réserve pour sortir la connexion de la file et la
+// refermer aussitôt. Sans réserve (ou si un autre worker a pris le fd libéré), suspendre
+// l'accept jusqu'à la prochaine fermeture ou, au plus tard, ACCEPT_RETRY_MS.
+void EpollClasse::rejectConnection(int server_fd)
+{
+    int client_fd = -1;
+    if (_reserveFd != -1) {
+        close(_reserveFd);
+        client_fd = accept4(server_fd, NULL, NULL, SOCK_CLOEXEC);
+        if (client_fd != -1) {
+            close(client_fd);
+            Logger::logMsg(RED, CONSOLE_OUTPUT, "Out of file descriptors, connection dropped");
+        }
+        _reserveFd = open("/dev/null", O_RDONLY | O_CLOEXEC);
+    }
+    if (client_fd == -1) {
+        pauseListeners();
+        _listenersPausedUntil = timeoutManager.now() + ACCEPT_RETRY_MS;
+    }
+}
+
+// Table des fd : réutilise l'objet existant à cet indice, sinon l'alloue
+FdContext* EpollClasse::acquireContext(int fd, FdRole role)
+{
+    if (static_cast<size_t>(fd) >= _fdTable.size()) {
+        _fdTable.resize(fd + 1, NULL);
+    }
+    if (!_fdTable[fd]) {
+        _fdTable[fd] = new FdContext();
+    } else {
+        *_fdTable[fd] = FdContext();
+    }
+    _fdTable[fd]->fd = fd;
+    _fdTable[fd]->role = role;
+    return _fdTable[fd];
+}
+
+// Le fd est fermé : l'objet reste en place (pointeur encore visible par epoll) mais inactif
+void EpollClasse::releaseContext(int fd)
+{
+    FdContext* ctx = getContext(fd);
+    if (ctx) {
+        *ctx = FdContext();
+    }
+}
+
+FdContext* EpollClasse::getContext(int fd)
+{
+    if (fd < 0 || static_cast<size_t>(fd) >= _fdTable.size() || !_fdTable[fd] || _fdTable[fd]->role == FD_UNUSED) {
+        return NULL;
+    }
+    return _fdTable[fd];
+}
+
+// Contexte d'un client encore ouvert, NULL sinon
+FdContext* EpollClasse::getClient(int fd)
+{
+    FdContext* ctx = getContext(fd);
+    return (ctx && ctx->role == FD_CLIENT) ? ctx : NULL;
+}
+
+// Masque epoll effectif : EPOLLET ajouté en mode edge-triggered
+uint32_t EpollClasse::eventMask(uint32_t events) const
+{
+    return _edgeTriggered ? (events | EPOLLET) : events;
 }
 
 // Configuration des serveurs
@@ -126,9 +289,19 @@ void EpollClasse::setupServers(std::vector<ServerConfig> servers, const std::vec
     _servers = servers;
     _serverConfigs = &serverConfigs;
 
+    // Premières lectures de tête dans des petits blocs, à la taille de la plus grande fenêtre
+    size_t headerBufferSize = 0;
+    for (std::vector<Server>::const_iterator it = serverConfigs.begin(); it != serverConfigs.end(); ++it) {
+        if (it->client_header_buffer_size > headerBufferSize) {
+            headerBufferSize = it->client_header_buffer_size;
+        }
+    }
+    _bufferManager.setSmallBufferSize(headerBufferSize);
+
     for (std::vector<ServerConfig>::iterator it = _servers.begin(); it != _servers.end(); ++it)
     {
-        it->setupServer();
+        it->setupServer(ProcessControl::takeInheritedListener(it->getHost(), it->getPort()));
+        ProcessControl::registerListener(it->getHost(), it->getPort(), it->getFd());
         Logger::logMsg(LIGHTMAGENTA, CONSOLE_OUTPUT, "Server Created on %s:%d", 
                       it->getHost().c_str(), it->getPort());
 
@@ -141,19 +314,82 @@ void EpollClasse::setupServers(std::vector<ServerConfig> servers, const std::vec
         }
 
         epoll_event event;
-        event.events = EPOLLIN; // Use level-triggered mode for more reliable operation
-        event.data.fd = it->getFd();
+        event.events = eventMask(EPOLLIN);
+        event.data.ptr = acquireContext(it->getFd(), FD_LISTENER);
 
         addToEpoll(it->getFd(), event);
     }
 }
 
-// Boucle principale
-void EpollClasse::serverRun() {
-    static int timeout_check_counter = 0;
+// Pipes de signaux : SIGQUIT pour toutes les boucles, SIGUSR2 pour une seule
+void EpollClasse::watchSignals(bool handleUpgrade)
+{
+    epoll_event event;
+    event.events = eventMask(EPOLLIN);
+    event.data.ptr = acquireContext(ProcessControl::quitFd(), FD_SIGNAL);
+    addToEpoll(ProcessControl::quitFd(), event);
+    if (handleUpgrade) {
+        event.data.ptr = acquireContext(ProcessControl::upgradeFd(), FD_SIGNAL);
+        addToEpoll(ProcessControl::upgradeFd(), event);
+    }
+}
+
+// SIGQUIT : fermer les connexions inactives et les listeners ; les requêtes en cours
+// (réponses en file, CGI, requêtes partielles) se terminent avec "Connection: close"
+void EpollClasse::beginDrain()
+{
+    if (_draining) {
+        return;
+    }
+    _draining = true;
+    int signalFds[2] = { ProcessControl::quitFd(), ProcessControl::upgradeFd() };
+    for (int i = 0; i < 2; ++i) {
+        if (getContext(signalFds[i])) {
+            epoll_ctl(_epoll_fd, EPOLL_CTL_DEL, signalFds[i], NULL);
+            releaseContext(signalFds[i]);
+        }
+    }
     
-    while (true) {
-        int event_count = epoll_wait(_epoll_fd, _events, MAX_EVENTS, 10); // Reduced to 10ms for better responsiveness
+    // Inactif = entre deux requêtes keep-alive, sans octet en attente (une connexion neuve
+    // ou une requête déjà arrivée mais pas encore lue obtient sa réponse)
+    for (size_t fd = 0; fd < _fdTable.size(); ++fd) {
+        FdContext* client = getClient(static_cast<int>(fd));
+        if (!client || client->keepAlive.requestCount == 0 || !client->responses.empty()
+            || _bufferManager.getBufferSize(static_cast<int>(fd)) > 0) {
+            continue;
+        }
+        char peek;
+        if (recv(static_cast<int>(fd), &peek, 1, MSG_PEEK | MSG_DONTWAIT) > 0) {
+            continue;
+        }
+        closeClient(static_cast<int>(fd));
+    }
+    
+    // Reprendre les connexions déjà en file du noyau avant de fermer les sockets d'écoute
+    for (std::vector<ServerConfig>::iterator it = _servers.begin(); it != _servers.end(); ++it) {
+        int server_fd = it->getFd();
+        if (server_fd == -1) {
+            continue;
+        }
+        if (!_listenersPaused) {
+            acceptConnection(server_fd);
+        }
+        epoll_ctl(_epoll_fd, EPOLL_CTL_DEL, server_fd, NULL);
+        releaseContext(server_fd);
+        it->closeSocket();
+    }
+    _listenersPaused = false;
+    _listenersPausedUntil = 0;
+    Logger::logMsg(LIGHTMAGENTA, CONSOLE_OUTPUT, "Graceful shutdown: draining %zu client(s)", _clientCount);
+}
+
+// Boucle principale (sort après un arrêt gracieux, une fois tous les clients servis)
+void EpollClasse::serverRun() {
+    while (!_draining || _clientCount > 0) {
+        // Dormir jusqu'à la prochaine échéance (reprise de l'accept comprise) ; pas du tout
+        // si des fd n'ont pas été drainés
+        int waitTimeout = _pendingContexts.empty() ? timeoutManager.nextTimeoutMs(_listenersPausedUntil) : 0;
+        int event_count = epoll_wait(_epoll_fd, _events, MAX_EVENTS, waitTimeout);
         if (event_count == -1) {
             if (errno == EINTR) {
                 continue; // Interruption par signal, continuer
@@ -161,90 +397,163 @@ void EpollClasse::serverRun() {
             Logger::logMsg(RED, CONSOLE_OUTPUT, "Epoll wait failed: %s", strerror(errno));
             throw std::runtime_error("Epoll wait failed");
         }
+        timeoutManager.updateClock(); // Une seule lecture d'horloge par tour
 
         // Traiter tous les événements d'un coup pour optimiser
         for (int i = 0; i < event_count; ++i) {
-            int fd = _events[i].data.fd;
-
-            if (_events[i].events & EPOLLIN) {
-                if (isServerFd(fd)) {
-                    acceptConnection(fd);
-                } else if (isCgiFd(fd)) {
-                    handleCgiOutput(fd);
-                } else {
-                    handleRequest(fd);
-                    timeoutManager.updateClientActivity(fd);
-                }
-            } else if (_events[i].events & EPOLLOUT) {
-                // Handle CGI stdin writing
-                if (isCgiStdinFd(fd)) {
-                    handleCgiStdinWrite(fd);
-                } else {
-                    // Handle client response writing
-                    handleClientWrite(fd);
-                }
-            } else if (_events[i].events & (EPOLLHUP | EPOLLERR | EPOLLRDHUP)) {
-                if (isCgiFd(fd)) {
-                    handleCgiOutput(fd);
-                } else {
-                    // Client disconnected or error
-                    Logger::logMsg(YELLOW, CONSOLE_OUTPUT, "Client %d disconnected (HUP/ERR)", fd);
-                    epoll_ctl(_epoll_fd, EPOLL_CTL_DEL, fd, NULL);
-                    timeoutManager.removeClient(fd);
-                    _bufferManager.clear(fd);
-                    cleanupClientResponse(fd);
-                    close(fd);
-                }
-            }
+            dispatchEvent(static_cast<FdContext*>(_events[i].data.ptr), _events[i].events);
         }
+        
+        // Reprendre les fd dont le budget d'E/S était épuisé au tour précédent
+        runPendingEvents();
 
-        // Optimisation: Check for timed-out clients moins fréquemment pour de meilleures performances
-        if (++timeout_check_counter >= 200) { // Réduit la fréquence de vérification des timeouts
-            timeout_check_counter = 0;
-            std::vector<int> timedOutClients = timeoutManager.getTimedOutClients();
-            for (std::vector<int>::iterator it = timedOutClients.begin(); it != timedOutClients.end(); ++it) {
-                // Log seulement les timeouts importants
-                if (_bufferManager.getBufferSize(*it) > 0) {
-                    Logger::logMsg(YELLOW, CONSOLE_OUTPUT, "Client %d timed out with pending data", *it);
-                }
-                epoll_ctl(_epoll_fd, EPOLL_CTL_DEL, *it, NULL);
-                close(*it);
-                timeoutManager.removeClient(*it);
-                _bufferManager.clear(*it);
-                cleanupClientResponse(*it);
+        // Échéances dépassées : clients inactifs et CGI trop longs partagent la même roue
+        std::vector<int> expired = timeoutManager.getTimedOutClients();
+        for (std::vector<int>::iterator it = expired.begin(); it != expired.end(); ++it) {
+            FdContext* ctx = getContext(*it);
+            if (!ctx) {
+                continue; // Fermé entre-temps (ex: CGI d'un client expiré juste avant)
             }
-        }
-        
-        // Optimisation: Check for timed-out CGI processes moins fréquemment
-        static int cgi_check_counter = 0;
-        if (++cgi_check_counter >= 200) { // Vérifier les CGI tous les 200 cycles
-            cgi_check_counter = 0;
-            time_t currentTime = time(NULL);
-            std::vector<int> timedOutCgi;
-            for (std::map<int, CgiProcess*>::iterator it = _cgiProcesses.begin(); it != _cgiProcesses.end(); ++it) {
-                CgiProcess* process = it->second;
-                if (currentTime - process->start_time > 3000) { // 30 second timeout
-                    timedOutCgi.push_back(it->first);
+            if (ctx->role == FD_CLIENT) {
+                // Log seulement les timeouts importants (pas la fin d'un keep-alive)
+                if (ctx->timers.phase != PHASE_IDLE && ctx->timers.phase != PHASE_LINGER) {
+                    static const char* phases[] = { "header", "body", "send", "idle", "linger" };
+                    Logger::logMsg(YELLOW, CONSOLE_OUTPUT, "Client %d timed out (%s)", *it, phases[ctx->timers.phase]);
                 }
-            }
-            
-            for (std::vector<int>::iterator it = timedOutCgi.begin(); it != timedOutCgi.end(); ++it) {
-                std::map<int, int>::iterator clientIt = _cgiToClient.find(*it);
-                if (clientIt != _cgiToClient.end()) {
-                    int client_fd = clientIt->second;
+                closeClient(*it);
+            } else if (ctx->role == FD_CGI_OUTPUT) {
+                Logger::logMsg(RED, CONSOLE_OUTPUT, "CGI process timeout (%d seconds), sending 504 error", CGI_TIMEOUT);
+                int client_fd = ctx->clientFd;
+                ResponseBuffer* slot = ctx->cgi->slot;
+                cleanupCgiProcess(*it);
+                FdContext* client = getClient(client_fd);
+                if (client) {
                     Server defaultServer;
                     if (!_serverConfigs->empty()) {
                         defaultServer = (*_serverConfigs)[0];
                     }
+                    // Le 504 prend la place réservée par le CGI dans la file du client
+                    SlotScope scope(_currentSlot, slot);
+                    if (slot) {
+                        slot->keepAlive = false;
+                    }
+                    client->keepAlive.closing = true;
                     sendErrorResponse(client_fd, 504, defaultServer);
-                    close(client_fd);
                 }
-                cleanupCgiProcess(*it);
             }
         }
+
+        // Accept suspendu faute de fd : nouvel essai, sauf si la boucle est pleine entre-temps
+        // (la prochaine fermeture le reprendra)
+        if (_listenersPausedUntil != 0 && timeoutManager.now() >= _listenersPausedUntil) {
+            _listenersPausedUntil = 0;
+            if (_clientCount < _maxClients) {
+                resumeListeners();
+            }
+        }
+    }
+    const StaticFileCache::Stats& cache = _fileCache.stats();
+    Logger::logMsg(LIGHTMAGENTA, CONSOLE_OUTPUT, "File cache: %zu hits, %zu misses, %zu evictions, %zu invalidations, %zu entries (%zu bytes)",
+                   cache.hits, cache.misses, cache.evictions, cache.invalidations, cache.entries, cache.bytes);
+    Logger::logMsg(LIGHTMAGENTA, CONSOLE_OUTPUT, "Worker drained, event loop stopped");
+}
+
+// Distribuer un événement epoll (ou un événement en attente) selon le rôle du fd
+void EpollClasse::dispatchEvent(FdContext* ctx, uint32_t events) {
+    int fd = ctx->fd;
+    switch (ctx->role) {
+        case FD_LISTENER:
+            if (events & EPOLLIN) {
+                acceptConnection(fd);
+            }
+            break;
+        case FD_CGI_OUTPUT:
+            if (events & (EPOLLIN | EPOLLHUP | EPOLLERR)) {
+                handleCgiOutput(fd);
+            }
+            break;
+        case FD_CGI_PID:
+            if (events & (EPOLLIN | EPOLLHUP | EPOLLERR)) {
+                handleCgiExit(fd);
+            }
+            break;
+        case FD_SIGNAL:
+            if (fd == ProcessControl::upgradeFd()) {
+                ProcessControl::upgrade();
+            } else {
+                beginDrain();
+            }
+            break;
+        case FD_FILE_CACHE:
+            _fileCache.handleEvents(); // En edge-triggered aussi : lu jusqu'à EAGAIN
+            break;
+        case FD_CGI_INPUT:
+            if (events & (EPOLLOUT | EPOLLHUP | EPOLLERR)) {
+                handleCgiStdinWrite(fd);
+            }
+            break;
+        case FD_CLIENT:
+            if (events & EPOLLIN) {
+                handleRequest(fd); // handleRequest met à jour l'activité (le fd peut être fermé ensuite)
+                // En edge-triggered, un front EPOLLOUT reçu avec EPOLLIN ne sera pas renvoyé
+                if (_edgeTriggered && (events & EPOLLOUT) && ctx->role == FD_CLIENT && ctx->inEpollOut) {
+                    handleClientWrite(fd);
+                }
+            } else if (events & EPOLLOUT) {
+                // Handle client response writing
+                handleClientWrite(fd);
+            } else if (events & (EPOLLHUP | EPOLLERR | EPOLLRDHUP)) {
+                // Client disconnected or error
+                Logger::logMsg(YELLOW, CONSOLE_OUTPUT, "Client %d disconnected (HUP/ERR)", fd);
+                closeClient(fd);
+            }
+            break;
+        case FD_UNUSED:
+            break; // fd fermé plus tôt dans le même lot d'événements
+    }
+}
+
+// Edge-triggered : le fd n'a pas été drainé jusqu'à EAGAIN, aucun nouveau front ne viendra
+void EpollClasse::markPending(int fd, uint32_t events) {
+    FdContext* ctx = getContext(fd);
+    if (!ctx) {
+        return;
+    }
+    if (ctx->pendingEvents == 0) {
+        _pendingContexts.push_back(ctx);
+    }
+    ctx->pendingEvents |= events;
+}
+
+// Un tour de plus pour chaque fd en attente ; ceux qui épuisent encore leur budget se réinscrivent
+void EpollClasse::runPendingEvents() {
+    if (_pendingContexts.empty()) {
+        return;
+    }
+    std::vector<FdContext*> pending;
+    pending.swap(_pendingContexts);
+    for (std::vector<FdContext*>::iterator it = pending.begin(); it != pending.end(); ++it) {
+        // releaseContext remet pendingEvents à zéro : les fd fermés depuis sont ignorés
+        uint32_t events = (*it)->pendingEvents;
+        (*it)->pendingEvents = 0;
+        if (events != 0) {
+            dispatchEvent(*it, events);
+        }
     }
 }
 
+// Vérifier si le FD est un serveur
+bool EpollClasse::isServerFd(int fd) {
+    FdContext* ctx = getContext(fd);
+    return ctx && ctx->role == FD_LISTENER;
+}
+
+// Vérifier si le FD est un CGI
+bool EpollClasse::isCgiFd(int fd) {
+    FdContext* ctx = getContext(fd);
+    return ctx && ctx->role == FD_CGI_OUTPUT;
+}
+
 // Ajouter un descripteur à epoll
 void EpollClasse::addToEpoll(int fd, epoll_event &event)
 {
@@ -260,22 +569,18 @@ void EpollClasse::addToEpoll(int fd, epoll_event &event)
     }
 }
 
-// Vérifier si le FD est un serveur
-bool EpollClasse::isServerFd(int fd) {
-    for (std::vector<ServerConfig>::iterator it = _servers.begin(); it != _servers.end(); ++it) {
-        if (fd == it->getFd()) {
-            return true;
+// Trouve un serveur correspondant à un hôte et un port donnés.
+// Premier serveur qui écoute sur port (sinon le premier) ; sans journalisation
+const Server& EpollClasse::defaultServerForPort(int port) const {
+    for (size_t i = 0; i < _serverConfigs->size(); ++i) {
+        const Server& server = (*_serverConfigs)[i];
+        if (std::find(server.listen_ports.begin(), server.listen_ports.end(), port) != server.listen_ports.end()) {
+            return server;
         }
     }
-    return false;
+    return (*_serverConfigs)[0];
 }
 
-// Vérifier si le FD est un CGI
-bool EpollClasse::isCgiFd(int fd) {
-    return _cgiProcesses.find(fd) != _cgiProcesses.end();
-}
-
-// Trouve un serveur correspondant à un hôte et un port donnés.
 int EpollClasse::findMatchingServer(const std::string& host, int port) {
     int defaultIndex = -1;
     for (size_t i = 0; i < _serverConfigs->size(); ++i) {
@@ -317,7 +622,12 @@ void EpollClasse::acceptConnection(int server_fd)
     // Accepter autant de connexions que possible d'un coup pour améliorer les performances
     int connections_accepted = 0;
     while (connections_accepted < 50) { // Augmenté à 50 pour les stress tests
-        int client_fd = accept(server_fd, (struct sockaddr *)&client_address, &addrlen);
+        if (_clientCount >= _maxClients) {
+            pauseListeners();
+            break;
+        }
+        // Socket non bloquant et fermé à l'exec (CGI) dès l'accept, sans fcntl
+        int client_fd = accept4(server_fd, (struct sockaddr *)&client_address, &addrlen, SOCK_NONBLOCK | SOCK_CLOEXEC);
         if (client_fd == -1)
         {
             if (errno == EAGAIN || errno == EWOULDBLOCK) {
@@ -328,19 +638,18 @@ void EpollClasse::acceptConnection(int server_fd)
             if (errno == ECONNABORTED || errno == EPROTO || errno == EINTR) {
                 continue;
             }
+            if (errno == EMFILE || errno == ENFILE) {
+                // Sans cela, le listener (toujours prêt) ferait tourner la boucle à vide
+                rejectConnection(server_fd);
+                if (_listenersPaused) {
+                    break;
+                }
+                continue;
+            }
             Logger::logMsg(RED, CONSOLE_OUTPUT, "Accept failed: %s", strerror(errno));
             return;
         }
 
-        // Vérifier que le fd est valide
-        if (client_fd >= FD_SETSIZE) {
-            Logger::logMsg(RED, CONSOLE_OUTPUT, "Client fd %d too high, closing", client_fd);
-            close(client_fd);
-            continue;
-        }
-
-        setNonBlocking(client_fd);
-        
         // Optimize socket for better performance
         int flag = 1;
         setsockopt(client_fd, IPPROTO_TCP, TCP_NODELAY, &flag, sizeof(flag)); // Disable Nagle's algorithm
@@ -351,16 +660,36 @@ void EpollClasse::acceptConnection(int server_fd)
         setsockopt(client_fd, SOL_SOCKET, SO_SNDBUF, &sendbuf_size, sizeof(sendbuf_size));
         setsockopt(client_fd, SOL_SOCKET, SO_RCVBUF, &recvbuf_size, sizeof(recvbuf_size));
         
-        timeoutManager.addClient(client_fd);
+        FdContext* client = acquireContext(client_fd, FD_CLIENT);
+        
+        // Port local lu une seule fois : sert au routage Host de chaque requête
+        struct sockaddr_in local_address;
+        socklen_t local_len = sizeof(local_address);
+        if (getsockname(client_fd, (struct sockaddr *)&local_address, &local_len) == 0) {
+            client->localPort = ntohs(local_address.sin_port);
+        }
+
+        // Limites de tête du serveur par défaut du port : le Host n'est connu qu'après la tête
+        const Server& defaultServer = defaultServerForPort(client->localPort);
+        _bufferManager.setHeaderLimits(client_fd, defaultServer.client_header_buffer_size,
+                                       defaultServer.large_client_header_buffers,
+                                       defaultServer.large_client_header_buffer_size);
+        client->timers.headerTimeout = defaultServer.client_header_timeout;
+        client->timers.bodyTimeout = defaultServer.client_body_timeout;
+        client->timers.sendTimeout = defaultServer.send_timeout;
+        client->timers.minRate = defaultServer.min_transfer_rate;
+        client->timers.phaseStart = timeoutManager.now();
+        updateClientDeadline(client_fd);
 
         epoll_event event;
-        event.events = EPOLLIN; // Use level-triggered for clients too
-        event.data.fd = client_fd;
+        event.events = eventMask(EPOLLIN);
+        event.data.ptr = client;
 
         if (epoll_ctl(_epoll_fd, EPOLL_CTL_ADD, client_fd, &event) == -1) {
             Logger::logMsg(RED, CONSOLE_OUTPUT, "Failed to add client fd %d to epoll: %s", client_fd, strerror(errno));
             close(client_fd);
             timeoutManager.removeClient(client_fd);
+            releaseContext(client_fd);
             continue; // Continuer au lieu de break pour traiter d'autres connexions
         }
 
@@ -368,9 +697,15 @@ void EpollClasse::acceptConnection(int server_fd)
             _biggest_fd = client_fd;
         }
 
+        _clientCount++;
         connections_accepted++;
     }
     
+    // Edge-triggered : file d'attente du listener peut-être non vide, reprendre au tour suivant
+    if (_edgeTriggered && connections_accepted >= 50) {
+        markPending(server_fd, EPOLLIN);
+    }
+    
     // Log seulement si on a accepté des connexions
     if (connections_accepted > 0) {
         Logger::logMsg(GREEN, CONSOLE_OUTPUT, "Accepted %d connection(s)", connections_accepted);
@@ -434,91 +769,352 @@ std::string EpollClasse::resolvePath(const Server &server, const std::string &re
     return smartJoinRootAndPath(server.root, requestedPath);
 }    // Gérer une requête client
 void EpollClasse::handleRequest(int client_fd) {
-    // Use simple malloc for reading buffer
-    char* buffer = static_cast<char*>(malloc(BUFFER_SIZE));
+    FdContext* client = getClient(client_fd);
+    if (!client) {
+        return;
+    }
+    
+    // Level-triggered : une lecture par réveil ; edge-triggered : drainer jusqu'à EAGAIN (dans la limite du budget)
+    if (client->lingering) {
+        discardLingeringInput(client_fd);
+        return;
+    }
+    int readBudget = _edgeTriggered ? MAX_IO_PER_EVENT : 1;
+    bool drained = false;
+    bool peerClosed = false;
+    bool dataReceived = false;
     
-    ssize_t bytes_read = read(client_fd, buffer, BUFFER_SIZE - 1);
+    for (int reads = 0; reads < readBudget; ++reads) {
+        // Lecture directe dans la chaîne de blocs du client (pool de la boucle, sans copie)
+        ssize_t bytes_read = _bufferManager.readFrom(client_fd);
 
-    if (bytes_read < 0) {
-        if (errno == EAGAIN || errno == EWOULDBLOCK) {
-            // No data available for now - this shouldn't happen with level-triggered
-            free(buffer);
-            return;
-        } else {
+        if (bytes_read < 0) {
+            if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                // Plus rien à lire pour le moment
+                drained = true;
+                break;
+            }
             Logger::logMsg(RED, CONSOLE_OUTPUT, "Error reading from FD %d: %s", client_fd, strerror(errno));
-            epoll_ctl(_epoll_fd, EPOLL_CTL_DEL, client_fd, NULL);
-            timeoutManager.removeClient(client_fd);
+            closeClient(client_fd);
+            return;
+        } else if (bytes_read == 0) {
+            // Client closed connection (les requêtes déjà lues sont servies d'abord)
+            peerClosed = true;
+            break;
+        }
+
+        // Connexion en cours de fermeture : la réponse finale est déjà en file, ignorer la suite
+        if (client->keepAlive.closing) {
             _bufferManager.clear(client_fd);
-            close(client_fd);
-            free(buffer);
+            continue;
+        }
+
+        // We have data
+        dataReceived = true;
+        client->timers.bytesRead += bytes_read;
+        
+        // Check buffer size limit to prevent memory attacks
+        size_t currentBufferSize = _bufferManager.getBufferSize(client_fd);
+        if (currentBufferSize > 1000000000) { // 1GB limit
+            Logger::logMsg(RED, CONSOLE_OUTPUT, "Buffer too large for fd %d, closing connection", client_fd);
+            _bufferManager.clear(client_fd);
+            client->keepAlive.closing = true;
+            sendErrorResponse(client_fd, 413, _serverConfigs->empty() ? Server() : (*_serverConfigs)[0]);
             return;
         }
-    } else if (bytes_read == 0) {
-        // Client closed connection
-        Logger::logMsg(YELLOW, CONSOLE_OUTPUT, "Client FD %d closed the connection", client_fd);
-        epoll_ctl(_epoll_fd, EPOLL_CTL_DEL, client_fd, NULL);
-        timeoutManager.removeClient(client_fd);
-        _bufferManager.clear(client_fd);
-        close(client_fd);
-        free(buffer);
-        return;
     }
-
-    // We have data
-    _bufferManager.append(client_fd, buffer, bytes_read);  // overload it
-    timeoutManager.updateClientActivity(client_fd);
     
-    // Check buffer size limit to prevent memory attacks
-    size_t currentBufferSize = _bufferManager.getBufferSize(client_fd);
-    if (currentBufferSize > 1000000000) { // 1GB limit
-        Logger::logMsg(RED, CONSOLE_OUTPUT, "Buffer too large for fd %d, closing connection", client_fd);
-        sendErrorResponse(client_fd, 413, _serverConfigs->empty() ? Server() : (*_serverConfigs)[0]);
-        epoll_ctl(_epoll_fd, EPOLL_CTL_DEL, client_fd, NULL);
-        timeoutManager.removeClient(client_fd);
-        _bufferManager.clear(client_fd);
-        close(client_fd);
-        return;
+    // Budget épuisé sans EAGAIN : epoll ne signalera plus ce fd, le reprendre au tour suivant
+    if (_edgeTriggered && !drained && !peerClosed) {
+        markPending(client_fd, EPOLLIN);
     }
     
-    // Mettre à jour l'activité du client pour éviter les timeouts sur les gros corps
-    timeoutManager.updateClientActivity(client_fd);
+    if (dataReceived) {
+        // Traiter toutes les requêtes complètes présentes dans le buffer (pipelining)
+        processBufferedRequests(client_fd);
+    }
     
-    // Check if we have a complete HTTP request
-    if (!_bufferManager.isRequestComplete(client_fd)) {
-        free(buffer);
+    if (peerClosed && client->role == FD_CLIENT) {
+        Logger::logMsg(YELLOW, CONSOLE_OUTPUT, "Client FD %d closed the connection", client_fd);
+        closeClient(client_fd);
+    }
+    if (dataReceived && client->role == FD_CLIENT) {
+        updateClientDeadline(client_fd);
+    }
+}
+
+// Échéance du client d'après sa phase. La tête doit arriver entière dans
+// client_header_timeout : un octet de temps en temps ne la repousse pas. Le corps et
+// l'envoi expirent après leur délai sans progrès et, avec min_transfer_rate, dès que
+// la phase a pris plus que ce délai plus le temps dû à ce débit pour ses octets.
+void EpollClasse::updateClientDeadline(int client_fd) {
+    FdContext* client = getClient(client_fd);
+    if (!client) {
         return;
     }
+    ClientTimers& timers = client->timers;
+    ClientPhase phase;
+    if (client->lingering) {
+        phase = PHASE_LINGER;
+    } else if (!client->responses.empty()) {
+        phase = PHASE_SEND;
+    } else if (_bufferManager.isReadingBody(client_fd)) {
+        phase = PHASE_BODY;
+    } else if (_bufferManager.getBufferSize(client_fd) > 0 || client->keepAlive.requestCount == 0) {
+        phase = PHASE_HEADER;
+    } else {
+        phase = PHASE_IDLE;
+    }
+
+    TimeoutManager::msec_t now = timeoutManager.now();
+    size_t bytes = (phase == PHASE_SEND) ? timers.bytesSent : timers.bytesRead;
+    if (phase != timers.phase) {
+        timers.phase = phase;
+        timers.phaseStart = timers.lastProgress = now;
+        timers.phaseBytes = timers.lastBytes = bytes;
+    } else if (bytes != timers.lastBytes) {
+        timers.lastProgress = now;
+        timers.lastBytes = bytes;
+    }
+
+    TimeoutManager::msec_t deadline;
+    if (phase == PHASE_LINGER) {
+        deadline = timers.lastProgress + LINGER_TIMEOUT_MS;
+        if (deadline > timers.phaseStart + LINGER_TIME_MS) {
+            deadline = timers.phaseStart + LINGER_TIME_MS;
+        }
+    } else if (phase == PHASE_HEADER) {
+        deadline = timers.phaseStart + static_cast<TimeoutManager::msec_t>(timers.headerTimeout) * 1000;
+    } else if (phase == PHASE_IDLE) {
+        deadline = timers.phaseStart + static_cast<TimeoutManager::msec_t>(client->keepAlive.idleTimeout) * 1000;
+    } else {
+        TimeoutManager::msec_t timeout = static_cast<TimeoutManager::msec_t>(
+            (phase == PHASE_BODY) ? timers.bodyTimeout : timers.sendTimeout) * 1000;
+        deadline = timers.lastProgress + timeout;
+        if (timers.minRate > 0) {
+            TimeoutManager::msec_t due = timers.phaseStart + timeout
+                + static_cast<TimeoutManager::msec_t>((bytes - timers.phaseBytes) * 1000 / timers.minRate);
+            if (due < deadline) {
+                deadline = due;
+            }
+        }
+    }
+    timeoutManager.setClientDeadline(client_fd, deadline);
+}
 
-    std::string request = _bufferManager.get(client_fd);
-    _bufferManager.clear(client_fd);
+// Fait avancer l'analyse jusqu'à une requête complète. A la fin de la tête, la limite du
+// corps est fixée d'après le serveur et la location visés, avant tout octet de corps :
+// un Content-Length trop grand reçoit son 413 sans attendre le corps, et un client qui
+// attend "100 Continue" n'envoie jamais un corps refusé. Une erreur de cadrage ou un corps
+// trop grand reçoit sa réponse et ferme la connexion.
+bool EpollClasse::nextRequestReady(int client_fd) {
+    while (true) {
+        HttpRequestParser::Status status = _bufferManager.advance(client_fd);
+        if (status == HttpRequestParser::PARSE_COMPLETE) {
+            return true;
+        }
+        if (status == HttpRequestParser::PARSE_INCOMPLETE) {
+            return false;
+        }
+        FdContext* client = getClient(client_fd);
+        if (!client || client->keepAlive.closing) {
+            return false;
+        }
+        const HttpRequest& pending = _bufferManager.pendingRequest(client_fd);
+        const Server& server = serverForRequest(client, pending);
+        if (status == HttpRequestParser::PARSE_HEAD_READY) {
+            std::string target = pending.getTarget();
+            std::string path;
+            if (_paths.canonical(target.substr(0, target.find('?')), path) != PathNormalizer::PATH_OK) {
+                path = "/"; // Refusée (400) au traitement ; limites du serveur en attendant
+            }
+            _bufferManager.setBodyBufferSize(client_fd, bodyBufferSize(server, path));
+            client->timers.bodyTimeout = server.client_body_timeout;
+            client->timers.sendTimeout = server.send_timeout;
+            client->timers.minRate = server.min_transfer_rate;
+            _bufferManager.setBodyLimit(client_fd, maxBodySize(server, path));
+            if (_bufferManager.getErrorStatus(client_fd) == 0) {
+                prepareUpload(client_fd, pending, server, path);
+            }
+            if (_bufferManager.getErrorStatus(client_fd) == 0 && !admitBody(client_fd, pending, server)) {
+                return false;
+            }
+            continue;
+        }
 
-    // Parser la requête HTTP avec validation renforcée
-    std::string method, path, protocol, fullPath;
-    std::istringstream requestStream(request);
-    
-    // Validation de base - vérifier que la première ligne est complète
-    std::string firstLine;
-    if (!std::getline(requestStream, firstLine) || firstLine.empty()) {
-        Logger::logMsg(RED, CONSOLE_OUTPUT, "Empty or invalid request line");
-        sendErrorResponse(client_fd, 400, _serverConfigs->empty() ? Server() : (*_serverConfigs)[0]);
-        epoll_ctl(_epoll_fd, EPOLL_CTL_DEL, client_fd, NULL);
-        timeoutManager.removeClient(client_fd);
-        _bufferManager.clear(client_fd);
-        close(client_fd);
+        int errorStatus = _bufferManager.getErrorStatus(client_fd);
+        Logger::logMsg(RED, CONSOLE_OUTPUT, "Invalid request on fd %d (%d), closing connection", client_fd, errorStatus);
+        rejectRequest(client_fd, errorStatus, server);
+        return false;
+    }
+}
+
+// Expect (RFC 7231 5.1.1) : "100 Continue" dès que le corps est admis, 417 pour toute
+// autre attente. Ignoré en HTTP/1.0 et pour les requêtes sans corps. Une requête que
+// processRequest refuserait d'après sa seule tête l'est avant le 100 : le client
+// n'envoie pas un corps perdu d'avance.
+bool EpollClasse::admitBody(int client_fd, const HttpRequest &request, const Server &server) {
+    const HttpHeaderField* expect = request.findHeader(HDR_EXPECT);
+    if (!expect || request.getVersion() == "HTTP/1.0") {
+        return true;
+    }
+    std::string value = request.str(expect->value);
+    for (size_t i = 0; i < value.length(); ++i) {
+        value[i] = tolower(static_cast<unsigned char>(value[i]));
+    }
+    if (value != "100-continue") {
+        Logger::logMsg(RED, CONSOLE_OUTPUT, "Unsupported expectation on fd %d: %s", client_fd, value.c_str());
+        rejectRequest(client_fd, 417, server);
+        return false;
+    }
+    if (!request.isChunked && request.contentLength == 0) {
+        return true;
+    }
+    if (rejectBeforeBody(client_fd, request, server)) {
+        return false;
+    }
+
+    // Réponse intermédiaire : un slot à part, déjà complet, placé après les réponses
+    // des requêtes pipelinées précédentes (sans en-tête Connection)
+    ResponseBuffer* slot = openResponseSlot(client_fd);
+    slot->data = "HTTP/1.1 100 Continue\r\n\r\n";
+    slot->keepAlive = true;
+    slot->isComplete = true;
+    flushResponses(client_fd);
+    return getClient(client_fd) != NULL;
+}
+
+// Réponse d'erreur sans lire la suite : la connexion se ferme après son envoi. response,
+// si elle est fournie, remplace la page d'erreur (405 avec Allow, redirection)
+void EpollClasse::rejectRequest(int client_fd, int statusCode, const Server &server, const std::string &response) {
+    FdContext* client = getClient(client_fd);
+    if (!client) {
         return;
     }
+    _bufferManager.clear(client_fd);
+    client->keepAlive.keepAlive = false;
+    client->keepAlive.closing = true;
+    if (response.empty()) {
+        sendErrorResponse(client_fd, statusCode, server);
+    } else {
+        sendResponse(client_fd, response);
+    }
+}
+
+// Contrôles de processRequest et handlePostRequest qui ne dépendent que de la tête : chemin,
+// méthode autorisée, redirection de la location, destination d'un POST. true si la
+// requête a été refusée (rejectRequest).
+bool EpollClasse::rejectBeforeBody(int client_fd, const HttpRequest &request, const Server &server) {
+    std::string target = request.getTarget();
+    std::string path;
+    if (_paths.canonical(target.substr(0, target.find('?')), path) != PathNormalizer::PATH_OK) {
+        rejectRequest(client_fd, 400, server);
+        return true;
+    }
+    std::string method = request.getMethod();
+    const Location* location = matchLocation(server, path);
+    std::vector<std::string> allowed = allowedMethods(server, location);
+    if (std::find(allowed.begin(), allowed.end(), method) == allowed.end()) {
+        rejectRequest(client_fd, 405, server, methodNotAllowedResponse(allowed));
+        return true;
+    }
+    if (location && location->return_code != 0) {
+        rejectRequest(client_fd, location->return_code, server,
+                      RedirectionHandler::generateRedirectReponse(location->return_code, location->return_url));
+        return true;
+    }
+    if (method != "POST" || isCgiPath(server, path)) {
+        return false;
+    }
+    std::string contentType = request.getHeader(HDR_CONTENT_TYPE);
+    int status = 0;
+    if (contentType.find("multipart/form-data") != std::string::npos) {
+        if (MultipartUpload::boundaryFrom(contentType).empty()) {
+            status = 400;
+        } else if (uploadDirectory(server).empty()) {
+            status = 403;
+        }
+    } else {
+        const Location* uploadLocation = server.findLocation(path);
+        if ((!uploadLocation || uploadLocation->upload_path.empty()) && server.upload_path.empty()) {
+            status = 404;
+        }
+    }
+    if (status != 0) {
+        rejectRequest(client_fd, status, server);
+        return true;
+    }
+    return false;
+}
+
+// Extraire et traiter une à une les requêtes complètes en tête du buffer
+void EpollClasse::processBufferedRequests(int client_fd) {
+    if (_processingFd == client_fd) {
+        return; // Réentrance via flushResponses : la boucle en cours s'en charge
+    }
+    _processingFd = client_fd;
     
-    // Supprimer les caractères de fin de ligne
-    if (!firstLine.empty() && firstLine[firstLine.length()-1] == '\r') {
-        firstLine = firstLine.substr(0, firstLine.length()-1);
+    while (nextRequestReady(client_fd)) {
+        FdContext* client = getClient(client_fd);
+        if (!client || client->keepAlive.closing) {
+            break;
+        }
+        // Trop de réponses en attente : reprendre quand la file se videra
+        if (client->responses.size() >= MAX_PIPELINED_REQUESTS) {
+            break;
+        }
+        
+        HttpRequest request;
+        _bufferManager.extractRequest(client_fd, request);
+        _currentSlot = openResponseSlot(client_fd);
+        processRequest(client_fd, request);
+        ResponseBuffer* slot = _currentSlot; // NULL si la réponse est déjà partie
+        _currentSlot = NULL;
+        
+        if (client->role != FD_CLIENT) {
+            break; // Connexion fermée pendant le traitement
+        }
+        if (slot && !slot->isComplete && !slot->deferred) {
+            // Aucun handler n'a répondu : ne jamais bloquer la file
+            client->keepAlive.keepAlive = false;
+            _currentSlot = slot;
+            sendErrorResponse(client_fd, 500, _serverConfigs->empty() ? Server() : (*_serverConfigs)[0]);
+            _currentSlot = NULL;
+            if (client->role != FD_CLIENT) {
+                break;
+            }
+        }
+        if (!client->keepAlive.keepAlive) {
+            // Les requêtes suivantes ne seront jamais servies
+            client->keepAlive.closing = true;
+            _bufferManager.clear(client_fd);
+            break;
+        }
     }
     
-    // Parser la première ligne
-    std::istringstream lineStream(firstLine);
-    lineStream >> method >> fullPath >> protocol;
+    _processingFd = -1;
+}
+
+// Traiter une requête HTTP complète
+void EpollClasse::processRequest(int client_fd, const HttpRequest &request) {
+    // Nouvelle requête sur la connexion : fermeture par défaut tant que le serveur n'est pas connu
+    FdContext* client = getClient(client_fd);
+    if (!client) {
+        return;
+    }
+    KeepAliveState& keepAliveState = client->keepAlive;
+    keepAliveState.keepAlive = false;
+    keepAliveState.requestCount++;
+    client->hasCookies = false;
+    client->cookies = CookieManager();
+
+    // Ligne de requête déjà découpée par HttpRequestParser à la réception
+    std::string method = request.getMethod();
+    std::string fullPath = request.getTarget();
+    std::string protocol = request.getVersion();
     
     // Extract clean path without query string
-    path = fullPath;
+    std::string path = fullPath;
     size_t questionPos = path.find('?');
     if (questionPos != std::string::npos) {
         path = path.substr(0, questionPos);
@@ -527,209 +1123,72 @@ void EpollClasse::handleRequest(int client_fd) {
     // Validation des requêtes malformées - cas plus stricts
     if (method.empty() || path.empty()) {
         Logger::logMsg(RED, CONSOLE_OUTPUT, "Malformed request: empty method or path");
+        keepAliveState.keepAlive = false;
         sendErrorResponse(client_fd, 400, _serverConfigs->empty() ? Server() : (*_serverConfigs)[0]);
-        epoll_ctl(_epoll_fd, EPOLL_CTL_DEL, client_fd, NULL);
-        timeoutManager.removeClient(client_fd);
-        _bufferManager.clear(client_fd);
-        close(client_fd);
         return;
     }
     
     // Validation de la longueur des éléments et caractères invalides
     if (method.length() > 10 || path.length() > 2048 || method.find('\0') != std::string::npos || path.find('\0') != std::string::npos) {
         Logger::logMsg(RED, CONSOLE_OUTPUT, "Malformed request: method or path too long or contains null bytes");
+        keepAliveState.keepAlive = false;
         sendErrorResponse(client_fd, 400, _serverConfigs->empty() ? Server() : (*_serverConfigs)[0]);
-        epoll_ctl(_epoll_fd, EPOLL_CTL_DEL, client_fd, NULL);
-        timeoutManager.removeClient(client_fd);
-        _bufferManager.clear(client_fd);
-        close(client_fd);
         return;
     }
     
     // Vérifier que le chemin commence par "/"
     if (path.empty() || path[0] != '/') {
         Logger::logMsg(RED, CONSOLE_OUTPUT, "Malformed request: path must start with /");
+        keepAliveState.keepAlive = false;
         sendErrorResponse(client_fd, 400, _serverConfigs->empty() ? Server() : (*_serverConfigs)[0]);
-        epoll_ctl(_epoll_fd, EPOLL_CTL_DEL, client_fd, NULL);
-        timeoutManager.removeClient(client_fd);
-        _bufferManager.clear(client_fd);
-        close(client_fd);
         return;
     }
+
+    // Forme canonique (décodée, sans "//", "." ni "..") : seule utilisée à partir d'ici
+    std::string canonicalPath;
+    PathNormalizer::Result pathResult = _paths.canonical(path, canonicalPath);
+    if (pathResult != PathNormalizer::PATH_OK) {
+        Logger::logMsg(RED, CONSOLE_OUTPUT, (pathResult == PathNormalizer::PATH_TRAVERSAL)
+                       ? "Security: Path traversal attempt blocked: %s" : "Malformed request: invalid escape in path: %s", path.c_str());
+        keepAliveState.keepAlive = false;
+        sendErrorResponse(client_fd, 400, _serverConfigs->empty() ? Server() : (*_serverConfigs)[0]);
+        return;
+    }
+    path.swap(canonicalPath);
     
     // Vérifier que le protocole est HTTP/1.1 ou HTTP/1.0
     if (!protocol.empty() && protocol != "HTTP/1.1" && protocol != "HTTP/1.0") {
         Logger::logMsg(RED, CONSOLE_OUTPUT, "Unsupported protocol: %s", protocol.c_str());
+        keepAliveState.keepAlive = false;
         sendErrorResponse(client_fd, 505, _serverConfigs->empty() ? Server() : (*_serverConfigs)[0]); // HTTP Version Not Supported
-        epoll_ctl(_epoll_fd, EPOLL_CTL_DEL, client_fd, NULL);
-        timeoutManager.removeClient(client_fd);
-        _bufferManager.clear(client_fd);
-        close(client_fd);
         return;
     }
     
     // Si aucun protocole n'est spécifié, c'est malformé en HTTP strict
     if (protocol.empty()) {
         Logger::logMsg(RED, CONSOLE_OUTPUT, "Malformed request: missing HTTP protocol");
+        keepAliveState.keepAlive = false;
         sendErrorResponse(client_fd, 400, _serverConfigs->empty() ? Server() : (*_serverConfigs)[0]);
-        epoll_ctl(_epoll_fd, EPOLL_CTL_DEL, client_fd, NULL);
-        timeoutManager.removeClient(client_fd);
-        _bufferManager.clear(client_fd);
-        close(client_fd);
         return;
     }
 
-    // Gestion du chunked encoding - supporter au lieu de rejeter
-    if (request.find("Transfer-Encoding: chunked") != std::string::npos) {
-        Logger::logMsg(YELLOW, CONSOLE_OUTPUT, "Chunked encoding detected - processing as normal request");
-        // Pour les tests, on traite les requêtes chunked comme des requêtes normales
-        // En production, il faudrait implémenter le décodage chunked
-    }
-
     if (path.empty())
         path = "/";
 
-    // Extract host header and route to appropriate server
-    std::string hostHeader;
-    {
-        size_t pos = request.find("Host:");
-        if (pos != std::string::npos) {
-            pos += 5;
-            size_t end = request.find("\r\n", pos);
-            hostHeader = request.substr(pos, end - pos);
-            // Trim whitespace
-            hostHeader.erase(0, hostHeader.find_first_not_of(" \t"));
-            hostHeader.erase(hostHeader.find_last_not_of(" \t") + 1);
-        }
-    }
-    // Parse host and optional port
-    std::string hostName;
-    int port = 0;
-    {
-        size_t colonPos = hostHeader.find(":");
-        if (colonPos != std::string::npos) {
-            hostName = hostHeader.substr(0, colonPos);
-            std::istringstream iss(hostHeader.substr(colonPos + 1));
-            int parsedPort;
-            if (!(iss >> parsedPort)) {
-                Logger::logMsg(RED, CONSOLE_OUTPUT, "Port invalide dans l'en-tête Host: %s", hostHeader.c_str());
-            } else {
-                port = parsedPort;
-            }
-        } else {
-            hostName = hostHeader;
-        }
-    }
+    // Serveur visé d'après l'en-tête Host et le port local
+    const Server& server = serverForRequest(client, request);
 
-    // Déterminer le port local si aucun port n'est spécifié
-    if (port == 0) {
-        struct sockaddr_in addr;
-        socklen_t len = sizeof(addr);
-        if (getsockname(client_fd, (struct sockaddr*)&addr, &len) == 0)
-            port = ntohs(addr.sin_port);
-    }
-    // Utilisation de la variable existante hostName
-    {
-        size_t colonPos = hostHeader.find(":");
-        if (colonPos != std::string::npos) {
-            hostName = hostHeader.substr(0, colonPos);
-            std::istringstream iss(hostHeader.substr(colonPos + 1));
-            int parsedPort;
-            if (!(iss >> parsedPort)) {
-                Logger::logMsg(RED, CONSOLE_OUTPUT, "Port invalide dans l'en-tête Host: %s", hostHeader.c_str());
-            } else {
-                port = parsedPort;
-            }
-        } else {
-            hostName = hostHeader;
-        }
-    }
+    // Décider si la connexion reste ouverte après cette réponse
+    keepAliveState.idleTimeout = server.keepalive_timeout;
+    keepAliveState.keepAlive = !_draining && wantsKeepAlive(protocol, request)
+                               && server.keepalive_timeout > 0
+                               && keepAliveState.requestCount < server.keepalive_requests;
 
-    // Déterminer le port local si aucun port n'est spécifié
-    if (port == 0) {
-        struct sockaddr_in addr;
-        socklen_t len = sizeof(addr);
-        if (getsockname(client_fd, (struct sockaddr*)&addr, &len) == 0)
-            port = ntohs(addr.sin_port);
-    }
-    int idx = findMatchingServer(hostName, port);
-    if (idx < 0) idx = 0;
-    const Server& server = (*_serverConfigs)[idx];
-
-    // Trouver la location correspondante (plus long préfixe)
-const Location* matchedLocation = NULL;
-size_t bestSpecificity = 0;
-
-for (std::vector<Location>::const_iterator it = server.locations.begin();
-     it != server.locations.end(); ++it)
-{
-    const std::string& pattern = it->path;
-    bool doesMatch = false;
-    size_t spec = 0;
-
-    if (pattern.find_first_of("*?") != std::string::npos) {
-        // wildcarded pattern
-        if (fnmatch(pattern.c_str(), path.c_str(), 0) == 0) {
-            doesMatch = true;
-            // count non‑wildcard chars as specificity
-            spec = pattern.length() - std::count(pattern.begin(), pattern.end(), '*')
-                                  - std::count(pattern.begin(), pattern.end(), '?');
-        }
-    } else {
-        // plain prefix
-        if (path.compare(0, pattern.length(), pattern) == 0) {
-            doesMatch = true;
-            spec = pattern.length();
-        }
-    }
-
-    if (doesMatch && spec > bestSpecificity) {
-        matchedLocation   = &(*it);
-        bestSpecificity   = spec;
-    }
-}
-    // Vérification des allow_methods AVANT tout autre traitement
-    std::vector<std::string> allowedMethods;
-    
-    if (matchedLocation && !matchedLocation->allow_methods.empty()) {
-        // Utiliser les méthodes de la location
-        allowedMethods = matchedLocation->allow_methods;
-    } else if (!server.allow_methods.empty()) {
-        // Utiliser les méthodes du serveur
-        allowedMethods = server.allow_methods;
-    } else {
-        // Valeurs par défaut si aucune configuration
-        allowedMethods.push_back("GET");
-        allowedMethods.push_back("POST");
-        allowedMethods.push_back("DELETE");
-    }
-    
-    // Vérifier si la méthode est autorisée
-    bool allowed = false;
-    for (size_t i = 0; i < allowedMethods.size(); ++i) {
-        if (allowedMethods[i] == method) {
-            allowed = true;
-            break;
-        }
-    }
-    
-    if (!allowed) {
-        // Générer la liste des méthodes autorisées
-        std::string allowHeader = "Allow: ";
-        for (size_t i = 0; i < allowedMethods.size(); ++i) {
-            if (i > 0) allowHeader += ", ";
-            allowHeader += allowedMethods[i];
-        }
-        std::string body = "<html><body><h1>405 Method Not Allowed</h1></body></html>";
-        std::ostringstream response;
-        response << "HTTP/1.1 405 Method Not Allowed\r\n"
-                 << allowHeader << "\r\n"
-                 << "Content-Type: text/html\r\n"
-                 << "Content-Length: " << body.size() << "\r\n"
-                 << "\r\n"
-                 << body;
-        sendResponse(client_fd, response.str());
-        close(client_fd);
+    // Location correspondante, puis allow_methods AVANT tout autre traitement
+    const Location* matchedLocation = matchLocation(server, path);
+    std::vector<std::string> allowed = allowedMethods(server, matchedLocation);
+    if (std::find(allowed.begin(), allowed.end(), method) == allowed.end()) {
+        sendResponse(client_fd, methodNotAllowedResponse(allowed));
         return;
     }
 
@@ -743,17 +1202,12 @@ for (std::vector<Location>::const_iterator it = server.locations.begin();
         std::string redirectResponse = RedirectionHandler::generateRedirectReponse(
             matchedLocation->return_code, matchedLocation->return_url);
         sendResponse(client_fd, redirectResponse);
-        close(client_fd);
         return;
     }
 
     // Utiliser resolvePath pour obtenir le chemin réel
     std::string resolvedPath = resolvePath(server, path);
     
-    // Parser les headers de la requête
-    std::map<std::string, std::string> headers = parseHeaders(request);
-    std::string body = parseBody(request);
-    
     // Extract query string from the full path
     std::string queryString = "";
     size_t queryPos = fullPath.find('?');
@@ -767,39 +1221,83 @@ for (std::vector<Location>::const_iterator it = server.locations.begin();
     // Traiter selon la méthode HTTP
     if (method == "GET" || method == "HEAD") {
         if (method == "HEAD") {
-            handleHeadRequest(client_fd, path, server);
+            handleHeadRequest(client_fd, path, server, request);
         } else {
-            handleGetRequest(client_fd, path, server, headers, queryString);
+            handleGetRequest(client_fd, path, server, request, queryString);
         }
     } else if (method == "POST") {
-        handlePostRequest(client_fd, path, body, headers, server, queryString);
+        handlePostRequest(client_fd, path, request, server, queryString);
     } else if (method == "DELETE") {
         handleDeleteRequest(client_fd, path, server);
     } else {
         // Méthode non supportée
         sendErrorResponse(client_fd, 501, server);
     }
-    // For CGI requests, don't close the connection here - let CGI handler manage it
-    // Check if this was a CGI request by looking for the client_fd in our CGI tracking
-    bool isCgiRequest = false;
-    for (std::map<int, int>::iterator cgiIt = _cgiToClient.begin(); cgiIt != _cgiToClient.end(); ++cgiIt) {
-        if (cgiIt->second == client_fd) {
-            isCgiRequest = true;
-            break;
+    // La connexion n'est plus fermée ici : flushResponses() la ferme ou la garde
+    // ouverte une fois la réponse (éventuellement CGI) entièrement envoyée
+}
+
+// Location d'un chemin canonique : motif à jokers (fnmatch) ou préfixe, la plus spécifique
+const Location* EpollClasse::matchLocation(const Server &server, const std::string &path) {
+    const Location* matchedLocation = NULL;
+    size_t bestSpecificity = 0;
+    for (std::vector<Location>::const_iterator it = server.locations.begin();
+         it != server.locations.end(); ++it) {
+        const std::string& pattern = it->path;
+        bool doesMatch = false;
+        size_t spec = 0;
+        if (pattern.find_first_of("*?") != std::string::npos) {
+            // wildcarded pattern
+            if (fnmatch(pattern.c_str(), path.c_str(), 0) == 0) {
+                doesMatch = true;
+                // count non-wildcard chars as specificity
+                spec = pattern.length() - std::count(pattern.begin(), pattern.end(), '*')
+                                      - std::count(pattern.begin(), pattern.end(), '?');
+            }
+        } else if (path.compare(0, pattern.length(), pattern) == 0) {
+            // plain prefix
+            doesMatch = true;
+            spec = pattern.length();
+        }
+        if (doesMatch && spec > bestSpecificity) {
+            matchedLocation = &(*it);
+            bestSpecificity = spec;
         }
     }
-    
-    if (!isCgiRequest) {
-        // Not a CGI request, safe to close
-        epoll_ctl(_epoll_fd, EPOLL_CTL_DEL, client_fd, NULL);
-        timeoutManager.removeClient(client_fd);
-        _bufferManager.clear(client_fd);
-        close(client_fd);
+    return matchedLocation;
+}
+
+// Méthodes de la location, sinon du serveur, sinon GET, POST et DELETE
+std::vector<std::string> EpollClasse::allowedMethods(const Server &server, const Location *location) {
+    if (location && !location->allow_methods.empty()) {
+        return location->allow_methods;
     }
-    // If it's a CGI request, the connection will be closed when CGI completes
-    
-    // Clean up buffer allocation
-    free(buffer);
+    if (!server.allow_methods.empty()) {
+        return server.allow_methods;
+    }
+    std::vector<std::string> methods;
+    methods.push_back("GET");
+    methods.push_back("POST");
+    methods.push_back("DELETE");
+    return methods;
+}
+
+// 405 avec l'en-tête Allow des méthodes autorisées
+std::string EpollClasse::methodNotAllowedResponse(const std::vector<std::string> &allowedMethods) {
+    std::string allowHeader = "Allow: ";
+    for (size_t i = 0; i < allowedMethods.size(); ++i) {
+        if (i > 0) allowHeader += ", ";
+        allowHeader += allowedMethods[i];
+    }
+    std::string body = "<html><body><h1>405 Method Not Allowed</h1></body></html>";
+    std::ostringstream response;
+    response << "HTTP/1.1 405 Method Not Allowed\r\n"
+             << allowHeader << "\r\n"
+             << "Content-Type: text/html\r\n"
+             << "Content-Length: " << body.size() << "\r\n"
+             << "\r\n"
+             << body;
+    return response.str();
 }
 
 // Fonction utilitaire pour envoyer une réponse (maintenant non-bloquante)
@@ -830,15 +1328,15 @@ void EpollClasse::setNonBlocking(int fd) {
 }
 
 // Génération de réponse HTTP
-std::string EpollClasse::generateHttpResponse(int statusCode, const std::string &contentType, 
-                                            const std::string &body, const std::map<std::string, std::string> &headers) {
+// Ligne de statut et en-têtes jusqu'à la ligne vide, pour un corps envoyé à part
+std::string EpollClasse::generateHttpHeaders(int statusCode, const std::string &contentType, size_t contentLength,
+                                           const std::map<std::string, std::string> &headers) {
     std::ostringstream response;
     response << "HTTP/1.1 " << statusCode << " " << getStatusCodeString(statusCode) << "\r\n";
     response << "Date: " << getCurrentDateTime() << "\r\n";
     response << "Server: Webserv/1.0\r\n";
     response << "Content-Type: " << contentType << "\r\n";
-    response << "Content-Length: " << body.length() << "\r\n";
-    response << "Connection: close\r\n";
+    response << "Content-Length: " << contentLength << "\r\n";
     
     // Ajouter les headers personnalisés
     for (std::map<std::string, std::string>::const_iterator it = headers.begin(); 
@@ -846,10 +1344,17 @@ std::string EpollClasse::generateHttpResponse(int statusCode, const std::string
         response << it->first << ": " << it->second << "\r\n";
     }
     
-    response << "\r\n" << body;
+    response << "\r\n";
     return response.str();
 }
 
+std::string EpollClasse::generateHttpResponse(int statusCode, const std::string &contentType, 
+                                            const std::string &body, const std::map<std::string, std::string> &headers) {
+    std::string response = generateHttpHeaders(statusCode, contentType, body.length(), headers);
+    response += body;
+    return response;
+}
+
 // Generate HTTP response with cookies for a specific client
 std::string EpollClasse::generateHttpResponseWithCookies(int client_fd, int statusCode, const std::string &contentType, 
                                                         const std::string &body, const std::map<std::string, std::string> &headers) {
@@ -859,7 +1364,6 @@ std::string EpollClasse::generateHttpResponseWithCookies(int client_fd, int stat
     response << "Server: Webserv/1.0\r\n";
     response << "Content-Type: " << contentType << "\r\n";
     response << "Content-Length: " << body.length() << "\r\n";
-    response << "Connection: close\r\n";
     
     // Add custom headers
     for (std::map<std::string, std::string>::const_iterator it = headers.begin(); 
@@ -868,8 +1372,9 @@ std::string EpollClasse::generateHttpResponseWithCookies(int client_fd, int stat
     }
     
     // Add Set-Cookie headers if any cookies are set for this client
-    if (_clientCookies.find(client_fd) != _clientCookies.end()) {
-        std::vector<std::string> cookieHeaders = _clientCookies[client_fd].generateSetCookieHeaders();
+    FdContext* client = getClient(client_fd);
+    if (client && client->hasCookies) {
+        std::vector<std::string> cookieHeaders = client->cookies.generateSetCookieHeaders();
         for (std::vector<std::string>::const_iterator it = cookieHeaders.begin();
              it != cookieHeaders.end(); ++it) {
             response << "Set-Cookie: " << *it << "\r\n";
@@ -883,17 +1388,25 @@ std::string EpollClasse::generateHttpResponseWithCookies(int client_fd, int stat
 // Obtenir la chaîne de statut HTTP
 std::string EpollClasse::getStatusCodeString(int statusCode) {
     switch (statusCode) {
+        case 100: return "Continue";
         case 200: return "OK";
         case 201: return "Created";
         case 204: return "No Content";
+        case 206: return "Partial Content";
         case 301: return "Moved Permanently";
         case 302: return "Found";
+        case 304: return "Not Modified";
         case 400: return "Bad Request";
         case 401: return "Unauthorized";
         case 403: return "Forbidden";
         case 404: return "Not Found";
         case 405: return "Method Not Allowed";
+        case 412: return "Precondition Failed";
         case 413: return "Request Entity Too Large";
+        case 414: return "URI Too Long";
+        case 416: return "Range Not Satisfiable";
+        case 417: return "Expectation Failed";
+        case 431: return "Request Header Fields Too Large";
         case 500: return "Internal Server Error";
         case 501: return "Not Implemented";
         case 504: return "Gateway Timeout";
@@ -902,12 +1415,13 @@ std::string EpollClasse::getStatusCodeString(int statusCode) {
 }
 
 // Obtenir la date/heure actuelle au format HTTP
-std::string EpollClasse::getCurrentDateTime() {
+const std::string& EpollClasse::getCurrentDateTime() {
     time_t now = time(0);
-    struct tm* gmt = gmtime(&now);
-    char buffer[100];
-    strftime(buffer, sizeof(buffer), "%a, %d %b %Y %H:%M:%S GMT", gmt);
-    return std::string(buffer);
+    if (now != _dateSecond) {
+        _dateSecond = now;
+        _date = httpDate(now);
+    }
+    return _date;
 }
 
 // Détection des types MIME
@@ -1052,146 +1566,63 @@ size_t EpollClasse::getFileSize(const std::string &filePath) {
     return 0;
 }
 
-// Parser les headers HTTP
-std::map<std::string, std::string> EpollClasse::parseHeaders(const std::string &request) {
-    std::map<std::string, std::string> headers;
-    std::istringstream stream(request);
-    std::string line;
-    
-    // Skip the first line (method, path, protocol)
-    std::getline(stream, line);
-    
-    while (std::getline(stream, line) && line != "\r") {
-        size_t colonPos = line.find(':');
-        if (colonPos != std::string::npos) {
-            std::string key = line.substr(0, colonPos);
-            std::string value = line.substr(colonPos + 1);
-            
-            // Trim whitespace
-            key.erase(0, key.find_first_not_of(" \t"));
-            key.erase(key.find_last_not_of(" \t\r\n") + 1);
-            value.erase(0, value.find_first_not_of(" \t"));
-            value.erase(value.find_last_not_of(" \t\r\n") + 1);
-            
-            headers[key] = value;
-        }
-    }
-    
-    return headers;
-}
-
-// Parser la méthode HTTP
-std::string EpollClasse::parseMethod(const std::string &request) {
-    std::istringstream stream(request);
-    std::string method;
-    stream >> method;
-    return method;
-}
-
-// Parser le chemin HTTP
-std::string EpollClasse::parsePath(const std::string &request) {
-    std::istringstream stream(request);
-    std::string method, path;
-    stream >> method >> path;
+// Limite du corps pour une requête, vérifiée pendant la réception
+size_t EpollClasse::maxBodySize(const Server &server, const std::string &path) {
+    const Location* location = server.findLocation(path);
+    size_t maxBodySize = location ? location->client_max_body_size : server.client_max_body_size;
     
-    // Supprimer la query string si présente
-    size_t questionPos = path.find('?');
-    if (questionPos != std::string::npos) {
-        path = path.substr(0, questionPos);
+    // Si maxBodySize est 0, utiliser une valeur par défaut
+    if (maxBodySize == 0) {
+        maxBodySize = server.client_max_body_size > 0 ? server.client_max_body_size : 1048576000; // 1GB par défaut
     }
-    
-    return path.empty() ? "/" : path;
+    return maxBodySize;
 }
 
-// Parser la query string
-std::string EpollClasse::parseQueryString(const std::string &request) {
-    std::istringstream stream(request);
-    std::string method, path;
-    stream >> method >> path;
-    
-    size_t questionPos = path.find('?');
-    if (questionPos != std::string::npos) {
-        return path.substr(questionPos + 1);
+// Seuil au-delà duquel le corps est écrit dans un fichier temporaire plutôt qu'en mémoire
+size_t EpollClasse::bodyBufferSize(const Server &server, const std::string &path) {
+    const Location* location = server.findLocation(path);
+    if (location && location->client_body_buffer_size > 0) {
+        return location->client_body_buffer_size;
     }
-    
-    return "";
+    return server.client_body_buffer_size;
 }
 
-// Parser le corps de la requête
-std::string EpollClasse::parseBody(const std::string &request) {
-    size_t bodyPos = request.find("\r\n\r\n");
-    if (bodyPos == std::string::npos) {
-        return "";
-    }
-    
-    std::string headers = request.substr(0, bodyPos);
-    std::string rawBody = request.substr(bodyPos + 4);
-    
-    // Check if it's chunked encoding
-    if (headers.find("Transfer-Encoding:") != std::string::npos && 
-        headers.find("chunked") != std::string::npos) {
-        return decodeChunkedBody(rawBody);
+// Serveur correspondant à l'en-tête Host (port local de la connexion par défaut)
+const Server& EpollClasse::serverForRequest(FdContext* client, const HttpRequest &request) {
+    std::string hostHeader = request.getHeader(HDR_HOST);
+    // Parse host and optional port
+    std::string hostName;
+    int port = 0;
+    {
+        size_t colonPos = hostHeader.find(":");
+        if (colonPos != std::string::npos) {
+            hostName = hostHeader.substr(0, colonPos);
+            std::istringstream iss(hostHeader.substr(colonPos + 1));
+            int parsedPort;
+            if (!(iss >> parsedPort)) {
+                Logger::logMsg(RED, CONSOLE_OUTPUT, "Port invalide dans l'en-tête Host: %s", hostHeader.c_str());
+            } else {
+                port = parsedPort;
+            }
+        } else {
+            hostName = hostHeader;
+        }
     }
-    
-    // Regular body (Content-Length)
-    return rawBody;
-}
 
-std::string EpollClasse::decodeChunkedBody(const std::string &chunkedData) {
-    std::string decodedBody;
-    size_t pos = 0;
-    
-    
-    while (pos < chunkedData.length()) {
-        // Find the end of the size line
-        size_t sizeEnd = chunkedData.find("\r\n", pos);
-        if (sizeEnd == std::string::npos) {
-            Logger::logMsg(RED, CONSOLE_OUTPUT, "❌ Invalid chunk: no CRLF after size");
-            break;
-        }
-        
-        // Extract chunk size (in hex)
-        std::string sizeStr = chunkedData.substr(pos, sizeEnd - pos);
-        
-        // Convert hex string to number
-        char* endptr;
-        unsigned long chunkSize = strtoul(sizeStr.c_str(), &endptr, 16);
-        
-        if (*endptr != '\0' && *endptr != ';') {  // Allow chunk extensions after ';'
-            Logger::logMsg(RED, CONSOLE_OUTPUT, "❌ Invalid chunk size: '%s'", sizeStr.c_str());
-            break;
-        }
-        
-        
-        // If chunk size is 0, we've reached the end
-        if (chunkSize == 0) {
-            break;
-        }
-        
-        // Move to start of chunk data (after size + CRLF)
-        pos = sizeEnd + 2;
-        
-        // Check if we have enough data
-        if (pos + chunkSize + 2 > chunkedData.length()) {
-            Logger::logMsg(RED, CONSOLE_OUTPUT, "❌ Incomplete chunk data");
-            break;
-        }
-        
-        // Extract chunk data
-        std::string chunkData = chunkedData.substr(pos, chunkSize);
-        decodedBody += chunkData;
-        
-        // Move past chunk data and trailing CRLF
-        pos += chunkSize + 2;
+    // Déterminer le port local si aucun port n'est spécifié (lu à l'accept)
+    if (port == 0) {
+        port = client->localPort;
     }
-    return decodedBody;
+    int idx = findMatchingServer(hostName, port);
+    if (idx < 0) idx = 0;
+    return (*_serverConfigs)[idx];
 }
 
 // Gestion des requêtes GET
 void EpollClasse::handleGetRequest(int client_fd, const std::string &path, const Server &server, 
-                                  const std::map<std::string, std::string> &headers, const std::string &queryString) {
+                                  const HttpRequest &request, const std::string &queryString) {
     // Parse cookies from request headers (for CGI scripts to access)
-    parseCookiesFromRequest(client_fd, headers);
+    parseCookiesFromRequest(client_fd, request);
     
     std::string resolvedPath = resolvePath(server, path);
     Logger::logMsg(GREEN, CONSOLE_OUTPUT, "GET request for path: %s -> %s", path.c_str(), resolvedPath.c_str());
@@ -1203,12 +1634,17 @@ void EpollClasse::handleGetRequest(int client_fd, const std::string &path, const
         std::string interpreter = server.getCgiInterpreterForPath(path, extension);
         // Check if it's a CGI script with interpreter OR a configured CGI extension (like .cgi for executables)
         if (!interpreter.empty() || server.cgi_extensions.find(extension) != server.cgi_extensions.end()) {
-            std::map<std::string, std::string> emptyHeaders;
-            handleCgiRequest(client_fd, resolvedPath, path, "GET", queryString, "", emptyHeaders, server);
+            handleCgiRequest(client_fd, resolvedPath, path, "GET", queryString, "", request, server);
             return; // CGI will handle connection closure
         }
     }
     
+    // Fichier en cache : ni stat, ni open (une requête Range passe par le fichier)
+    bool ranged = request.hasHeader(HDR_RANGE);
+    if (!ranged && serveCachedFile(client_fd, resolvedPath, server, request, false)) {
+        return;
+    }
+    
     // Vérifier d'abord si c'est un répertoire pour l'autoindex
     struct stat pathStat;
     if (stat(resolvedPath.c_str(), &pathStat) == 0 && S_ISDIR(pathStat.st_mode)) {
@@ -1226,11 +1662,11 @@ void EpollClasse::handleGetRequest(int client_fd, const std::string &path, const
             std::string indexFile = location ? location->index : server.index;
             if (!indexFile.empty()) {
                 std::string indexPath = joinPath(resolvedPath, indexFile);
+                if (!ranged && serveCachedFile(client_fd, indexPath, server, request, false)) {
+                    return;
+                }
                 if (fileExists(indexPath)) {
-                    std::string content = readFile(indexPath);
-                    std::string mimeType = getMimeType(indexPath);
-                    std::string response = generateHttpResponse(200, mimeType, content);
-                    queueResponse(client_fd, response);
+                    serveStaticFile(client_fd, indexPath, server, request);
                     return;
                 }
             }
@@ -1247,72 +1683,226 @@ void EpollClasse::handleGetRequest(int client_fd, const std::string &path, const
         return;
     }
     
-    Logger::logMsg(GREEN, CONSOLE_OUTPUT, "File exists, attempting to read: %s", resolvedPath.c_str());
-    
-    // Read and serve file content directly
-    std::string content = readFile(resolvedPath);
-    std::string mimeType = getMimeType(resolvedPath);
-    
+    serveStaticFile(client_fd, resolvedPath, server, request);
+}
+
+// Fichier statique : un petit fichier entre dans le cache et part de la mémoire ; au-delà,
+// seuls les en-têtes sont en mémoire, le corps part du fd par sendfile au fil des envois
+// (flushResponses), sans copie en espace utilisateur. Préconditions puis Range de la
+// requête GET évaluées sur le fstat du fichier ouvert.
+void EpollClasse::serveStaticFile(int client_fd, const std::string &filePath, const Server &server,
+                                  const HttpRequest &request) {
+    int fd = open(filePath.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd == -1) {
+        Logger::logMsg(RED, CONSOLE_OUTPUT, "Cannot open %s: %s", filePath.c_str(), strerror(errno));
+        sendErrorResponse(client_fd, (errno == EACCES) ? 403 : 404, server);
+        return;
+    }
+    struct stat st;
+    if (fstat(fd, &st) == -1 || !S_ISREG(st.st_mode)) {
+        close(fd);
+        sendErrorResponse(client_fd, 403, server);
+        return;
+    }
+    std::string etag = fileETag(st);
+    int precondition = checkPreconditions(request, st.st_mtime, etag);
+    if (precondition != 0) {
+        close(fd);
+        sendPreconditionResponse(client_fd, precondition, st.st_mtime, etag, server);
+        return;
+    }
+    if (request.hasHeader(HDR_RANGE) && ifRangeMatches(request, st, etag)) {
+        std::vector<ByteRange> ranges;
+        ByteRanges::Result result = ByteRanges::parse(request.getHeader(HDR_RANGE), st.st_size, ranges);
+        if (result == ByteRanges::RANGE_UNSATISFIABLE) {
+            close(fd);
+            std::map<std::string, std::string> headers;
+            headers["Content-Range"] = "bytes */" + sizeToString(st.st_size);
+            queueResponse(client_fd, generateHttpResponse(416, "text/html", "", headers));
+            return;
+        }
+        if (result == ByteRanges::RANGE_OK) {
+            serveFileRanges(client_fd, filePath, fd, st, ranges);
+            return;
+        }
+    }
+    const CachedResponse* cached = _fileCache.insert(filePath, fd, st, getMimeType(filePath));
+    if (cached) {
+        close(fd);
+        queueCachedFile(client_fd, *cached, false);
+        return;
+    }
     // Un fichier vide est valide, ne pas retourner d'erreur 500
-    Logger::logMsg(GREEN, CONSOLE_OUTPUT, "File read successfully: %s (%zu bytes)", resolvedPath.c_str(), content.length());
+    std::string headers = generateHttpHeaders(200, getMimeType(filePath), st.st_size, fileHeaders(st, etag));
+    if (st.st_size == 0) {
+        close(fd);
+        queueResponse(client_fd, headers);
+        return;
+    }
+    if (st.st_size >= STATIC_FADVISE_MIN) {
+        posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL); // Lecture anticipée plus agressive
+    }
+    Logger::logMsg(GREEN, CONSOLE_OUTPUT, "Serving %s (%lld bytes)", filePath.c_str(), static_cast<long long>(st.st_size));
+    queueResponse(client_fd, headers, fd, 0, st.st_size);
+}
+
+// 206 : un intervalle part tel quel ; plusieurs en multipart/byteranges, chaque tranche
+// par sendfile depuis le même fd, précédée des en-têtes de sa partie
+void EpollClasse::serveFileRanges(int client_fd, const std::string &filePath, int fd, const struct stat &st,
+                                  const std::vector<ByteRange> &ranges) {
+    std::string mimeType = getMimeType(filePath);
+    std::string total = "/" + sizeToString(st.st_size);
+    std::map<std::string, std::string> headers = fileHeaders(st, fileETag(st));
+    if (ranges.size() == 1) {
+        const ByteRange &range = ranges[0];
+        headers["Content-Range"] = "bytes " + sizeToString(range.first) + "-" + sizeToString(range.last) + total;
+        queueResponse(client_fd, generateHttpHeaders(206, mimeType, range.length(), headers), fd, range.first, range.length());
+        return;
+    }
     
-    std::string response = generateHttpResponse(200, mimeType, content);
+    char boundary[32];
+    snprintf(boundary, sizeof(boundary), "%08lx%08lx", static_cast<unsigned long>(time(NULL)), ++_boundarySerial);
+    std::vector<FileSegment> segments(ranges.size() + 1);
+    size_t contentLength = 0;
+    for (size_t i = 0; i < ranges.size(); ++i) {
+        segments[i].prefix = std::string("\r\n--") + boundary + "\r\nContent-Type: " + mimeType
+                             + "\r\nContent-Range: bytes " + sizeToString(ranges[i].first) + "-"
+                             + sizeToString(ranges[i].last) + total + "\r\n\r\n";
+        segments[i].offset = ranges[i].first;
+        segments[i].end = ranges[i].last + 1;
+        contentLength += segments[i].prefix.size() + ranges[i].length();
+    }
+    segments.back().prefix = std::string("\r\n--") + boundary + "--\r\n";
+    segments.back().offset = 0;
+    segments.back().end = 0;
+    contentLength += segments.back().prefix.size();
+    
+    std::string head = generateHttpHeaders(206, std::string("multipart/byteranges; boundary=") + boundary,
+                                           contentLength, headers);
+    ResponseBuffer* buffer = fillResponseSlot(client_fd, head + segments[0].prefix);
+    if (!buffer) {
+        close(fd);
+        return;
+    }
+    buffer->fileFd = fd;
+    buffer->fileOffset = segments[0].offset;
+    buffer->fileEnd = segments[0].end;
+    buffer->segments.swap(segments);
+    buffer->nextSegment = 1;
+    Logger::logMsg(GREEN, CONSOLE_OUTPUT, "Serving %s (%zu ranges)", filePath.c_str(), ranges.size());
+    flushResponses(client_fd);
+}
+
+// If-Range : les intervalles ne valent que pour la version du fichier que le client a
+// déjà. Comparaison forte : l'ETag exact (un tag faible ne correspond jamais), ou une
+// date égale à Last-Modified
+bool EpollClasse::ifRangeMatches(const HttpRequest &request, const struct stat &st, const std::string &etag) {
+    const HttpHeaderField* field = request.findHeader(HDR_IF_RANGE);
+    if (!field) {
+        return true;
+    }
+    std::string value = request.str(field->value);
+    if (value.empty() || value.compare(0, 2, "W/") == 0) {
+        return false;
+    }
+    if (value[0] == '"') {
+        return value == etag;
+    }
+    time_t date;
+    return parseHttpDate(value, date) && date == st.st_mtime;
+}
+
+// En-têtes d'un fichier statique servi en entier ou par intervalles
+std::map<std::string, std::string> EpollClasse::fileHeaders(const struct stat &st, const std::string &etag) {
+    std::map<std::string, std::string> headers;
+    headers["Accept-Ranges"] = "bytes";
+    headers["ETag"] = etag;
+    headers["Last-Modified"] = httpDate(st.st_mtime);
+    return headers;
+}
+
+// 304 sans corps, avec les validateurs de la représentation ; 412 comme une erreur
+void EpollClasse::sendPreconditionResponse(int client_fd, int statusCode, time_t lastModified, const std::string &etag,
+                                           const Server &server) {
+    if (statusCode != 304) {
+        sendErrorResponse(client_fd, statusCode, server);
+        return;
+    }
+    std::string response = "HTTP/1.1 304 Not Modified\r\n";
+    response += "Date: " + getCurrentDateTime() + "\r\n";
+    response += "Server: Webserv/1.0\r\n";
+    response += "ETag: " + etag + "\r\n";
+    response += "Last-Modified: " + httpDate(lastModified) + "\r\n";
+    response += "\r\n";
     queueResponse(client_fd, response);
 }
 
+// Réponse depuis le cache de fichiers, préconditions comprises ; false si filePath n'y
+// est pas (ou plus)
+bool EpollClasse::serveCachedFile(int client_fd, const std::string &filePath, const Server &server,
+                                  const HttpRequest &request, bool headOnly) {
+    const CachedResponse* cached = _fileCache.get(filePath);
+    if (!cached) {
+        return false;
+    }
+    int precondition = checkPreconditions(request, cached->lastModified, cached->etag);
+    if (precondition != 0) {
+        sendPreconditionResponse(client_fd, precondition, cached->lastModified, cached->etag, server);
+        return true;
+    }
+    queueCachedFile(client_fd, *cached, headOnly);
+    return true;
+}
+
+// Seules la ligne de statut et la date sont produites ici ; en-têtes fixes et corps
+// partent du buffer du cache, partagé tel quel
+void EpollClasse::queueCachedFile(int client_fd, const CachedResponse &cached, bool headOnly) {
+    std::string head;
+    head.reserve(96);
+    head = "HTTP/1.1 200 OK\r\nDate: ";
+    head += getCurrentDateTime();
+    head += "\r\n";
+    queueSharedResponse(client_fd, head, cached.buffer, 0, headOnly ? cached.headerSize : cached.buffer->data.size());
+}
+
 // Gestion des requêtes POST
-void EpollClasse::handlePostRequest(int client_fd, const std::string &path, const std::string &body, 
-                                  const std::map<std::string, std::string> &headers, const Server &server, const std::string &queryString) {
-    Logger::logMsg(GREEN, CONSOLE_OUTPUT, "POST request for path: %s (body size: %zu bytes)", path.c_str(), body.length());
-    
-    // Vérifier la taille du corps de la requête avec une logique plus robuste
+void EpollClasse::handlePostRequest(int client_fd, const std::string &path, const HttpRequest &request,
+                                  const Server &server, const std::string &queryString) {
+    // Corps décodé à la réception : en mémoire, ou dans un fichier temporaire s'il est gros
+    const std::string &body = request.body;
+    size_t bodyLength = request.bodyLength();
+    Logger::logMsg(GREEN, CONSOLE_OUTPUT, "POST request for path: %s (body size: %zu bytes%s)", path.c_str(), bodyLength,
+                   request.hasBodyFile() ? ", temp file" : "");
+    
+    // Déjà vérifiée à la réception ; contrôle conservé pour les corps injectés autrement
     const Location* location = server.findLocation(path);
-    size_t maxBodySize = location ? location->client_max_body_size : server.client_max_body_size;
-    
-    // Si maxBodySize est 0, utiliser une valeur par défaut
-    if (maxBodySize == 0) {
-        maxBodySize = server.client_max_body_size > 0 ? server.client_max_body_size : 1048576000; // 1GB par défaut
-    }
+    size_t maxBodySize = this->maxBodySize(server, path);
     
-    Logger::logMsg(GREEN, CONSOLE_OUTPUT, "Body size check: %zu bytes (max allowed: %zu bytes)", body.length(), maxBodySize);
+    Logger::logMsg(GREEN, CONSOLE_OUTPUT, "Body size check: %zu bytes (max allowed: %zu bytes)", bodyLength, maxBodySize);
     
-    if (body.length() > maxBodySize) {
-        Logger::logMsg(RED, CONSOLE_OUTPUT, "Request body too large: %zu bytes (max: %zu)", body.length(), maxBodySize);
+    if (bodyLength > maxBodySize) {
+        Logger::logMsg(RED, CONSOLE_OUTPUT, "Request body too large: %zu bytes (max: %zu)", bodyLength, maxBodySize);
         sendErrorResponse(client_fd, 413, server);
         return;
     }
     
-    std::string resolvedPath = resolvePath(server, path);
-    
-    // Vérifier si c'est un script CGI
-    size_t dotPos = resolvedPath.find_last_of('.');
-    if (dotPos != std::string::npos) {
-        std::string extension = resolvedPath.substr(dotPos);
-        std::string interpreter = server.getCgiInterpreterForPath(path, extension);
-        // Check if it's a CGI script with interpreter OR a configured CGI extension (like .cgi for executables)
-        if (!interpreter.empty() || server.cgi_extensions.find(extension) != server.cgi_extensions.end()) {
-            handleCgiRequest(client_fd, resolvedPath, path, "POST", queryString, body, headers, server);
-            return; // CGI will handle connection closure
-        }
+    // Vérifier si c'est un script CGI (interpréteur ou extension configurés, ex: .cgi)
+    if (isCgiPath(server, path)) {
+        handleCgiRequest(client_fd, resolvePath(server, path), path, "POST", queryString, body, request, server);
+        return; // CGI will handle connection closure
     }
     
     // Gestion de l'upload de fichiers
-    std::map<std::string, std::string>::const_iterator contentTypeIt = headers.find("Content-Type");
-    if (contentTypeIt != headers.end() && 
-        contentTypeIt->second.find("multipart/form-data") != std::string::npos) {
-        handleFileUpload(client_fd, body, headers, server);
+    if (request.getHeader(HDR_CONTENT_TYPE).find("multipart/form-data") != std::string::npos) {
+        handleFileUpload(client_fd, request, server);
         return;
     }
     
     // POST simple - écrire dans un fichier avec gestion robuste des gros corps
     if (location && !location->upload_path.empty()) {
         std::string uploadPath = location->upload_path + "/post_result.txt";
-        std::ofstream file(uploadPath.c_str(), std::ios::binary);
-        if (file.is_open()) {
-            file.write(body.c_str(), body.length());
-            file.close();
-            
-            Logger::logMsg(GREEN, CONSOLE_OUTPUT, "Large POST body written to %s (%zu bytes)", uploadPath.c_str(), body.length());
+        if (writeRequestBody(request, uploadPath)) {
+            Logger::logMsg(GREEN, CONSOLE_OUTPUT, "Large POST body written to %s (%zu bytes)", uploadPath.c_str(), bodyLength);
             std::string response = generateHttpResponse(201, "text/plain", "File uploaded successfully");
             queueResponse(client_fd, response);
         } else {
@@ -1322,12 +1912,8 @@ void EpollClasse::handlePostRequest(int client_fd, const std::string &path, cons
     } else if (!server.upload_path.empty()) {
         // Fallback sur l'upload_path du serveur
         std::string uploadPath = server.upload_path + "/post_result.txt";
-        std::ofstream file(uploadPath.c_str(), std::ios::binary);
-        if (file.is_open()) {
-            file.write(body.c_str(), body.length());
-            file.close();
-            
-            Logger::logMsg(GREEN, CONSOLE_OUTPUT, "Large POST body written to %s (%zu bytes)", uploadPath.c_str(), body.length());
+        if (writeRequestBody(request, uploadPath)) {
+            Logger::logMsg(GREEN, CONSOLE_OUTPUT, "Large POST body written to %s (%zu bytes)", uploadPath.c_str(), bodyLength);
             std::string response = generateHttpResponse(201, "text/plain", "File uploaded successfully");
             queueResponse(client_fd, response);
         } else {
@@ -1367,16 +1953,38 @@ void EpollClasse::handleDeleteRequest(int client_fd, const std::string &path, co
 }
 
 // Gestion des requêtes HEAD
-void EpollClasse::handleHeadRequest(int client_fd, const std::string &path, const Server &server) {
+// Fichier régulier : en-têtes du GET correspondant (taille, validateurs) tirés du seul
+// stat, le fichier n'est pas ouvert
+void EpollClasse::handleHeadRequest(int client_fd, const std::string &path, const Server &server,
+                                    const HttpRequest &request) {
     Logger::logMsg(GREEN, CONSOLE_OUTPUT, "HEAD request for path: %s", path.c_str());
     
     std::string resolvedPath = resolvePath(server, path);
+    if (serveCachedFile(client_fd, resolvedPath, server, request, true)) {
+        return;
+    }
     
-    if (!fileExists(resolvedPath)) {
+    struct stat pathStat;
+    if (stat(resolvedPath.c_str(), &pathStat) != 0) {
         Logger::logMsg(RED, CONSOLE_OUTPUT, "File not found for HEAD: %s", resolvedPath.c_str());
         sendErrorResponse(client_fd, 404, server);
         return;
     }
+    if (S_ISREG(pathStat.st_mode)) {
+        if (access(resolvedPath.c_str(), R_OK) != 0) {
+            sendErrorResponse(client_fd, 403, server); // Comme le GET, qui échouerait à l'open
+            return;
+        }
+        std::string etag = fileETag(pathStat);
+        int precondition = checkPreconditions(request, pathStat.st_mtime, etag);
+        if (precondition != 0) {
+            sendPreconditionResponse(client_fd, precondition, pathStat.st_mtime, etag, server);
+            return;
+        }
+        queueResponse(client_fd, generateHttpHeaders(200, getMimeType(resolvedPath), pathStat.st_size,
+                                                     fileHeaders(pathStat, etag)));
+        return;
+    }
     
     std::string mimeType = getMimeType(resolvedPath);
     
@@ -1395,7 +2003,16 @@ void EpollClasse::handleHeadRequest(int client_fd, const std::string &path, cons
 void EpollClasse::sendErrorResponse(int client_fd, int errorCode, const Server &server) {
     std::string errorPage = server.getErrorPage(errorCode);
     std::string content;
-    
+    const CachedResponse* cached = errorPage.empty() ? NULL : _fileCache.load(errorPage, "text/html");
+    
+    if (cached) {
+        // Corps seul : Accept-Ranges et les validateurs du cache décrivent le fichier servi
+        // en 200, pas cette réponse d'erreur
+        queueSharedResponse(client_fd, generateHttpHeaders(errorCode, "text/html", cached->bodySize()),
+                            cached->buffer, cached->headerSize, cached->bodySize());
+        Logger::logMsg(RED, CONSOLE_OUTPUT, "Sent error response %d to client %d", errorCode, client_fd);
+        return;
+    }
     if (!errorPage.empty() && fileExists(errorPage)) {
         content = readFile(errorPage);
     } else {
@@ -1418,89 +2035,103 @@ void EpollClasse::sendErrorResponse(int client_fd, int errorCode, const Server &
 // Gestion des erreurs de FD
 void EpollClasse::handleError(int fd) {
     Logger::logMsg(RED, CONSOLE_OUTPUT, "Error on FD %d, closing connection", fd);
-    epoll_ctl(_epoll_fd, EPOLL_CTL_DEL, fd, NULL);
-    close(fd);
-    timeoutManager.removeClient(fd);
+    closeClient(fd);
 }
 
-// Gestion de l'upload de fichiers multipart
-void EpollClasse::handleFileUpload(int client_fd, const std::string &body, 
-                                 const std::map<std::string, std::string> &headers, const Server &server) {
-    Logger::logMsg(GREEN, CONSOLE_OUTPUT, "Handling file upload");
-    
-    // Extraire le boundary du Content-Type
-    std::map<std::string, std::string>::const_iterator contentTypeIt = headers.find("Content-Type");
-    if (contentTypeIt == headers.end()) {
-        sendErrorResponse(client_fd, 400, server);
+// Ecrit le corps dans filePath ; depuis le fichier temporaire, copie par le noyau (sendfile)
+bool EpollClasse::writeRequestBody(const HttpRequest &request, const std::string &filePath) {
+    int fd = open(filePath.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd == -1) {
+        return false;
+    }
+    bool ok = true;
+    if (request.hasBodyFile()) {
+        off_t offset = 0;
+        while (ok && static_cast<size_t>(offset) < request.bodyFileSize) {
+            ssize_t n = sendfile(fd, request.bodyFd, &offset, request.bodyFileSize - offset);
+            ok = n > 0 || (n == -1 && errno == EINTR);
+        }
+    } else {
+        size_t written = 0;
+        while (ok && written < request.body.size()) {
+            ssize_t n = write(fd, request.body.data() + written, request.body.size() - written);
+            if (n > 0) {
+                written += n;
+            }
+            ok = n > 0 || (n == -1 && errno == EINTR);
+        }
+    }
+    return (close(fd) == 0) && ok;
+}
+
+// Répertoire d'upload : location "/" si elle en a un, sinon la première location qui en
+// a un, sinon celui du serveur ("" si aucun)
+std::string EpollClasse::uploadDirectory(const Server &server) {
+    const Location* location = server.findLocation("/");
+    if (location && !location->upload_path.empty()) {
+        return location->upload_path;
+    }
+    for (std::vector<Location>::const_iterator it = server.locations.begin(); 
+         it != server.locations.end(); ++it) {
+        if (!it->upload_path.empty()) {
+            return it->upload_path;
+        }
+    }
+    return server.upload_path;
+}
+
+// Script CGI (interpréteur ou extension configurés) : le corps lui revient tel quel
+bool EpollClasse::isCgiPath(const Server &server, const std::string &path) {
+    std::string resolvedPath = resolvePath(server, path);
+    size_t dotPos = resolvedPath.find_last_of('.');
+    if (dotPos == std::string::npos) {
+        return false;
+    }
+    std::string extension = resolvedPath.substr(dotPos);
+    return !server.getCgiInterpreterForPath(path, extension).empty()
+           || server.cgi_extensions.find(extension) != server.cgi_extensions.end();
+}
+
+// A la fin de la tête d'un POST multipart destiné à l'upload : les parties seront
+// analysées et écrites sur disque au fil de la réception, sans passer par le corps
+void EpollClasse::prepareUpload(int client_fd, const HttpRequest &request, const Server &server, const std::string &path) {
+    if (request.getMethod() != "POST") {
         return;
     }
-    
-    std::string contentType = contentTypeIt->second;
-    size_t boundaryPos = contentType.find("boundary=");
-    if (boundaryPos == std::string::npos) {
-        sendErrorResponse(client_fd, 400, server);
+    std::string contentType = request.getHeader(HDR_CONTENT_TYPE);
+    std::string boundary = MultipartUpload::boundaryFrom(contentType);
+    if (contentType.find("multipart/form-data") == std::string::npos || boundary.empty() || isCgiPath(server, path)) {
         return;
     }
+    std::string uploadDir = uploadDirectory(server);
+    if (!uploadDir.empty()) {
+        _bufferManager.setUpload(client_fd, new MultipartUpload(boundary, uploadDir));
+    }
+}
+
+// Gestion de l'upload de fichiers multipart : les fichiers sont déjà sur disque, sans nom,
+// il ne reste qu'à les nommer
+void EpollClasse::handleFileUpload(int client_fd, const HttpRequest &request, const Server &server) {
+    Logger::logMsg(GREEN, CONSOLE_OUTPUT, "Handling file upload");
     
-    std::string boundary = "--" + contentType.substr(boundaryPos + 9);
-    
-    // Parser les données multipart
-    std::map<std::string, std::string> formData = parseMultipartData(body, boundary);
-    
-    // Trouver la location correspondante pour l'upload
-    const Location* location = server.findLocation("/");
-    if (!location || location->upload_path.empty()) {
-        // Fallback: chercher n'importe quelle location avec upload_path
-        location = NULL;
-        for (std::vector<Location>::const_iterator it = server.locations.begin(); 
-             it != server.locations.end(); ++it) {
-            if (!it->upload_path.empty()) {
-                location = &(*it);
-                break;
-            }
-        }
-        // Si aucune location n'a d'upload_path, utiliser celui du serveur
-        if (!location && server.upload_path.empty()) {
+    if (!request.upload) {
+        // Pas analysé à la réception : boundary absent ou aucun répertoire d'upload
+        if (MultipartUpload::boundaryFrom(request.getHeader(HDR_CONTENT_TYPE)).empty()) {
+            sendErrorResponse(client_fd, 400, server);
+        } else {
             sendErrorResponse(client_fd, 403, server);
-            return;
         }
+        return;
     }
-    
-    bool uploadSuccess = false;
-    for (std::map<std::string, std::string>::iterator it = formData.begin(); 
-         it != formData.end(); ++it) {
-        if (it->first.find("filename=") != std::string::npos) {
-            // Extraire le nom du fichier
-            size_t filenamePos = it->first.find("filename=\"");
-            if (filenamePos != std::string::npos) {
-                filenamePos += 10; // longueur de "filename=\""
-                size_t filenameEnd = it->first.find("\"", filenamePos);
-                if (filenameEnd != std::string::npos) {
-                    std::string filename = it->first.substr(filenamePos, filenameEnd - filenamePos);
-                    
-                    // Sécuriser le nom de fichier (éviter path traversal)
-                    if (filename.find("..") != std::string::npos || filename.find("/") != std::string::npos) {
-                        continue;
-                    }
-                    
-                    // Utiliser upload_path de la location ou du serveur
-                    std::string uploadDir = (location && !location->upload_path.empty()) 
-                                           ? location->upload_path 
-                                           : server.upload_path;
-                    std::string uploadPath = uploadDir + "/" + filename;
-                    std::ofstream file(uploadPath.c_str(), std::ios::binary);
-                    if (file.is_open()) {
-                        file << it->second;
-                        file.close();
-                        uploadSuccess = true;
-                        Logger::logMsg(GREEN, CONSOLE_OUTPUT, "File uploaded: %s", uploadPath.c_str());
-                    }
-                }
-            }
-        }
+    if (request.upload->isMalformed() || !request.upload->isComplete()) {
+        Logger::logMsg(RED, CONSOLE_OUTPUT, "Malformed multipart body");
+        sendErrorResponse(client_fd, 400, server);
+        return;
     }
     
-    if (uploadSuccess) {
+    size_t saved = request.upload->commit();
+    if (saved > 0) {
+        Logger::logMsg(GREEN, CONSOLE_OUTPUT, "%zu file(s) uploaded to %s", saved, uploadDirectory(server).c_str());
         std::string response = generateHttpResponse(201, "text/html", 
             "<html><body><h1>Upload successful!</h1></body></html>");
         queueResponse(client_fd, response);
@@ -1509,47 +2140,10 @@ void EpollClasse::handleFileUpload(int client_fd, const std::string &body,
     }
 }
 
-// Parser les données multipart/form-data
-std::map<std::string, std::string> EpollClasse::parseMultipartData(const std::string &body, const std::string &boundary) {
-    std::map<std::string, std::string> formData;
-    
-    size_t pos = 0;
-    while (pos < body.length()) {
-        size_t boundaryPos = body.find(boundary, pos);
-        if (boundaryPos == std::string::npos) break;
-        
-        pos = boundaryPos + boundary.length();
-        if (pos >= body.length()) break;
-        
-        // Ignorer \r\n après boundary
-        if (pos + 1 < body.length() && body.substr(pos, 2) == "\r\n") {
-            pos += 2;
-        }
-        
-        // Trouver la fin des headers de cette partie
-        size_t headersEnd = body.find("\r\n\r\n", pos);
-        if (headersEnd == std::string::npos) break;
-        
-        std::string headers = body.substr(pos, headersEnd - pos);
-        pos = headersEnd + 4;
-        
-        // Trouver la fin du contenu de cette partie
-        size_t nextBoundary = body.find(boundary, pos);
-        if (nextBoundary == std::string::npos) break;
-        
-        std::string content = body.substr(pos, nextBoundary - pos - 2); // -2 pour \r\n
-        
-        formData[headers] = content;
-        pos = nextBoundary;
-    }
-    
-    return formData;
-}
-
 // Gestion des requêtes CGI
 void EpollClasse::handleCgiRequest(int client_fd, const std::string &scriptPath, const std::string &requestPath, const std::string &method,
                                  const std::string &queryString, const std::string &body,
-                                 const std::map<std::string, std::string> &headers, const Server &server) {
+                                 const HttpRequest &request, const Server &server) {
     Logger::logMsg(GREEN, CONSOLE_OUTPUT, "Handling CGI request: %s", scriptPath.c_str());
     
     // Check if the CGI script exists and is executable
@@ -1565,16 +2159,133 @@ void EpollClasse::handleCgiRequest(int client_fd, const std::string &scriptPath,
         return;
     }
     
-    // Check if we've reached the maximum number of concurrent CGI processes
-    if (_cgiProcesses.size() >= MAX_CGI_PROCESSES) {
-        Logger::logMsg(YELLOW, CONSOLE_OUTPUT, "Maximum CGI processes reached (%d), rejecting request", MAX_CGI_PROCESSES);
-        sendErrorResponse(client_fd, 503, server); // Service Unavailable
-        return;
+    // Check if we've reached the maximum number of concurrent CGI processes
+    if (_cgiCount >= MAX_CGI_PROCESSES) {
+        Logger::logMsg(YELLOW, CONSOLE_OUTPUT, "Maximum CGI processes reached (%d), rejecting request", MAX_CGI_PROCESSES);
+        sendErrorResponse(client_fd, 503, server); // Service Unavailable
+        return;
+    }
+    
+    // Préparer l'environnement et la ligne de commande AVANT fork : le fils
+    // d'un processus multi-thread ne doit appeler que des fonctions async-signal-safe
+    std::map<std::string, std::string> env;
+    for (char** envIt = environ; envIt && *envIt; ++envIt) {
+        const char* eq = strchr(*envIt, '=');
+        if (eq) {
+            env[std::string(*envIt, eq - *envIt)] = std::string(eq + 1);
+        }
+    }
+    
+    // Set up CGI environment variables
+    env["REQUEST_METHOD"] = method;
+    env["SCRIPT_NAME"] = scriptPath;
+    env["QUERY_STRING"] = queryString;
+    env["SERVER_PROTOCOL"] = "HTTP/1.1";
+    env["GATEWAY_INTERFACE"] = "CGI/1.1";
+    
+    // Set REQUEST_URI - the full original request URI including query string
+    std::string requestUri = requestPath;
+    if (!queryString.empty()) {
+        requestUri += "?" + queryString;
+    }
+    env["REQUEST_URI"] = requestUri;
+    
+    // Set PATH_INFO - using the request path as per CGI standard
+    // This should be the part of the URL after the script name
+    env["PATH_INFO"] = requestPath;
+    
+    // Set additional standard CGI variables
+    std::string serverName = server.server_names.empty() ? "localhost" : server.server_names[0];
+    std::ostringstream serverPort;
+    serverPort << (server.listen_ports.empty() ? 8000 : server.listen_ports[0]);
+    env["SERVER_NAME"] = serverName;
+    env["SERVER_PORT"] = serverPort.str();
+    env["REMOTE_ADDR"] = "127.0.0.1";
+    env["REMOTE_HOST"] = "localhost";
+    env["SERVER_SOFTWARE"] = "webserv/1.0";
+    
+    // Set DOCUMENT_ROOT if available
+    if (!server.root.empty()) {
+        env["DOCUMENT_ROOT"] = server.root;
+    }
+    
+    // Gros corps POST : le fichier temporaire devient directement le stdin du CGI
+    int bodyFileFd = (method == "POST" && request.hasBodyFile()) ? request.bodyFd : -1;
+    if (bodyFileFd != -1) {
+        env["CONTENT_LENGTH"] = sizeToString(request.bodyFileSize);
+        lseek(bodyFileFd, 0, SEEK_SET);
+    } else if (!body.empty()) {
+        env["CONTENT_LENGTH"] = sizeToString(body.length());
+    }
+    
+    // Set CONTENT_TYPE if present in headers
+    const HttpHeaderField* contentTypeField = request.findHeader(HDR_CONTENT_TYPE);
+    if (contentTypeField) {
+        env["CONTENT_TYPE"] = request.str(contentTypeField->value);
+    }
+    
+    // Add HTTP headers as environment variables
+    for (size_t f = 0; f < request.fields.size(); ++f) {
+        const HttpHeaderField& field = request.fields[f];
+        if (field.id != HDR_UNKNOWN) {
+            // Nom CGI précalculé dans HTTP_HEADERS
+            env[HTTP_HEADERS[field.id].cgiName] = request.str(field.value);
+            continue;
+        }
+        std::string envName = "HTTP_" + request.getFieldName(f);
+        // Replace dashes with underscores and convert to uppercase
+        for (size_t i = 0; i < envName.length(); ++i) {
+            if (envName[i] == '-') envName[i] = '_';
+            envName[i] = toupper(envName[i]);
+        }
+        env[envName] = request.str(field.value);
+    }
+    
+    std::vector<std::string> envStrings;
+    envStrings.reserve(env.size());
+    for (std::map<std::string, std::string>::const_iterator it = env.begin(); it != env.end(); ++it) {
+        envStrings.push_back(it->first + "=" + it->second);
+    }
+    std::vector<char*> envp;
+    envp.reserve(envStrings.size() + 1);
+    for (size_t i = 0; i < envStrings.size(); ++i) {
+        envp.push_back(const_cast<char*>(envStrings[i].c_str()));
+    }
+    envp.push_back(NULL);
+    
+    // Convert relative path to absolute path for exec
+    std::string absolutePath = scriptPath;
+    if (scriptPath[0] != '/') {
+        char* cwd = getcwd(NULL, 0);
+        if (cwd) {
+            absolutePath = std::string(cwd) + "/" + scriptPath;
+            free(cwd);
+        }
+    }
+    
+    // Determine interpreter
+    std::string interpreter;
+    size_t dotPos = scriptPath.find_last_of('.');
+    if (dotPos != std::string::npos) {
+        interpreter = server.getCgiInterpreterForPath(scriptPath, scriptPath.substr(dotPos));
     }
+    std::vector<char*> argv;
+    if (!interpreter.empty()) {
+        argv.push_back(const_cast<char*>(interpreter.c_str()));
+        // Special handling for AWK scripts
+        if (interpreter.find("awk") != std::string::npos) {
+            argv.push_back(const_cast<char*>("-f"));
+        }
+    }
+    argv.push_back(const_cast<char*>(absolutePath.c_str()));
+    argv.push_back(NULL);
     
-    // Create pipes for communication
-    int stdin_pipe[2], stdout_pipe[2];
-    if (pipe(stdin_pipe) == -1 || pipe(stdout_pipe) == -1) {
+    Logger::logMsg(GREEN, CONSOLE_OUTPUT, "Executing CGI: %s (original: %s)%s%s", absolutePath.c_str(), scriptPath.c_str(),
+                   interpreter.empty() ? "" : " with interpreter ", interpreter.c_str());
+    
+    // Create pipes for communication (O_CLOEXEC : ne pas fuiter dans les CGI des autres workers)
+    int stdin_pipe[2] = {-1, -1}, stdout_pipe[2] = {-1, -1};
+    if (pipe2(stdin_pipe, O_CLOEXEC) == -1 || pipe2(stdout_pipe, O_CLOEXEC) == -1) {
         Logger::logMsg(RED, CONSOLE_OUTPUT, "Failed to create pipes for CGI");
         sendErrorResponse(client_fd, 500, server);
         if (stdin_pipe[0] != -1) {
@@ -1601,121 +2312,17 @@ void EpollClasse::handleCgiRequest(int client_fd, const std::string &scriptPath,
     
     if (pid == 0) {
         // Child process - execute CGI script
-        close(stdin_pipe[1]);   // Close write end of stdin pipe
-        close(stdout_pipe[0]);  // Close read end of stdout pipe
-        
-        // Redirect stdin and stdout
-        dup2(stdin_pipe[0], STDIN_FILENO);
+        // Redirect stdin and stdout (dup2 retire O_CLOEXEC sur 0 et 1)
+        dup2((bodyFileFd != -1) ? bodyFileFd : stdin_pipe[0], STDIN_FILENO);
         dup2(stdout_pipe[1], STDOUT_FILENO);
         
-        close(stdin_pipe[0]);
-        close(stdout_pipe[1]);
-        
-        // Set up CGI environment variables
-        setenv("REQUEST_METHOD", method.c_str(), 1);
-        setenv("SCRIPT_NAME", scriptPath.c_str(), 1);
-        setenv("QUERY_STRING", queryString.c_str(), 1);
-        setenv("SERVER_PROTOCOL", "HTTP/1.1", 1);
-        setenv("GATEWAY_INTERFACE", "CGI/1.1", 1);
-        
-        // Set REQUEST_URI - the full original request URI including query string
-        std::string requestUri = requestPath;
-        if (!queryString.empty()) {
-            requestUri += "?" + queryString;
-        }
-        setenv("REQUEST_URI", requestUri.c_str(), 1);
-        
-        // Set PATH_INFO - using the request path as per CGI standard
-        // This should be the part of the URL after the script name
-        setenv("PATH_INFO", requestPath.c_str(), 1);
-
-        // Set additional standard CGI variables
-        std::string serverName = server.server_names.empty() ? "localhost" : server.server_names[0];
-        std::ostringstream serverPort;
-        serverPort << (server.listen_ports.empty() ? 8000 : server.listen_ports[0]);
-        setenv("SERVER_NAME", serverName.c_str(), 1);
-        setenv("SERVER_PORT", serverPort.str().c_str(), 1);
-        setenv("REMOTE_ADDR", "127.0.0.1", 1);
-        setenv("REMOTE_HOST", "localhost", 1);
-        setenv("SERVER_SOFTWARE", "webserv/1.0", 1);
-        
-        // Set DOCUMENT_ROOT if available
-        if (!server.root.empty()) {
-            setenv("DOCUMENT_ROOT", server.root.c_str(), 1);
-        }
-
-        if (!body.empty()) {
-            std::ostringstream contentLength;
-            contentLength << body.length();
-            setenv("CONTENT_LENGTH", contentLength.str().c_str(), 1);
-        }
-        
-        // Set CONTENT_TYPE if present in headers
-        std::map<std::string, std::string>::const_iterator contentTypeIt = headers.find("Content-Type");
-        if (contentTypeIt != headers.end()) {
-            setenv("CONTENT_TYPE", contentTypeIt->second.c_str(), 1);
-        }
-        
-        // Add HTTP headers as environment variables
-        for (std::map<std::string, std::string>::const_iterator it = headers.begin();
-             it != headers.end(); ++it) {
-            std::string envName = "HTTP_" + it->first;
-            // Replace dashes with underscores and convert to uppercase
-            for (size_t i = 0; i < envName.length(); ++i) {
-                if (envName[i] == '-') envName[i] = '_';
-                envName[i] = toupper(envName[i]);
-            }
-            setenv(envName.c_str(), it->second.c_str(), 1);
-        }
-        
-        // Determine interpreter
-        size_t dotPos = scriptPath.find_last_of('.');
-        if (dotPos != std::string::npos) {
-            std::string extension = scriptPath.substr(dotPos);
-            std::string interpreter = server.getCgiInterpreterForPath(scriptPath, extension);
-            
-            // Convert relative path to absolute path for exec
-            std::string absolutePath = scriptPath;
-            if (scriptPath[0] != '/') {
-                char* cwd = getcwd(NULL, 0);
-                if (cwd) {
-                    absolutePath = std::string(cwd) + "/" + scriptPath;
-                    free(cwd);
-                }
-            }
-            
-            // Debug: print the path we're trying to execute
-            Logger::logMsg(GREEN, CONSOLE_OUTPUT, "Executing CGI: %s (original: %s)", absolutePath.c_str(), scriptPath.c_str());
-            
-            if (!interpreter.empty()) {
-                Logger::logMsg(GREEN, CONSOLE_OUTPUT, "Using interpreter: %s", interpreter.c_str());
-                // Special handling for AWK scripts
-                if (interpreter.find("awk") != std::string::npos) {
-                    execl(interpreter.c_str(), interpreter.c_str(), "-f", absolutePath.c_str(), NULL);
-                } else {
-                    execl(interpreter.c_str(), interpreter.c_str(), absolutePath.c_str(), NULL);
-                }
-            } else {
-                Logger::logMsg(GREEN, CONSOLE_OUTPUT, "Executing directly (no interpreter)");
-                execl(absolutePath.c_str(), absolutePath.c_str(), NULL);
-            }
-        } else {
-            // Convert relative path to absolute path for exec
-            std::string absolutePath = scriptPath;
-            if (scriptPath[0] != '/') {
-                char* cwd = getcwd(NULL, 0);
-                if (cwd) {
-                    absolutePath = std::string(cwd) + "/" + scriptPath;
-                    free(cwd);
-                }
-            }
-            execl(absolutePath.c_str(), absolutePath.c_str(), NULL);
-        }
+        execve(argv[0], &argv[0], &envp[0]);
         
         // If we get here, exec failed
-        perror("execl failed");
-        Logger::logMsg(RED, CONSOLE_OUTPUT, "Failed to execute CGI script: %s", scriptPath.c_str());
-        exit(1);
+        const char msg[] = "webserv: failed to execute CGI script\n";
+        ssize_t ignored = write(STDERR_FILENO, msg, sizeof(msg) - 1);
+        (void)ignored;
+        _exit(1);
     } else {
         // Parent process
         close(stdin_pipe[0]);   // Close read end of stdin pipe
@@ -1744,16 +2351,21 @@ void EpollClasse::handleCgiRequest(int client_fd, const std::string &scriptPath,
             cgiProcess->stdin_fd = stdin_pipe[1];
             
             // Add stdin pipe to epoll for writing the body asynchronously
+            FdContext* stdinCtx = acquireContext(stdin_pipe[1], FD_CGI_INPUT);
+            stdinCtx->cgi = cgiProcess;
+            stdinCtx->clientFd = client_fd;
             epoll_event stdin_event;
-            stdin_event.events = EPOLLOUT;
-            stdin_event.data.fd = stdin_pipe[1];
+            stdin_event.events = eventMask(EPOLLOUT);
+            stdin_event.data.ptr = stdinCtx;
             
             if (epoll_ctl(_epoll_fd, EPOLL_CTL_ADD, stdin_pipe[1], &stdin_event) == -1) {
                 Logger::logMsg(RED, CONSOLE_OUTPUT, "Failed to add CGI stdin pipe to epoll");
-                delete cgiProcess;
+                releaseContext(stdin_pipe[1]);
                 close(stdin_pipe[1]);
                 close(stdout_pipe[0]);
-                kill(pid, SIGTERM);
+                kill(pid, SIGKILL);
+                watchCgiExit(pid, NULL);  // Récupérer le processus tué
+                delete cgiProcess;
                 sendErrorResponse(client_fd, 500, server);
                 return;
             }
@@ -1764,22 +2376,44 @@ void EpollClasse::handleCgiRequest(int client_fd, const std::string &scriptPath,
         }
         
         // Add CGI pipe to epoll for monitoring
+        FdContext* cgiCtx = acquireContext(stdout_pipe[0], FD_CGI_OUTPUT);
+        cgiCtx->cgi = cgiProcess;
+        cgiCtx->clientFd = client_fd;
         epoll_event event;
-        event.events = EPOLLIN; // Use level-triggered for CGI pipes too
-        event.data.fd = stdout_pipe[0];
+        event.events = eventMask(EPOLLIN);
+        event.data.ptr = cgiCtx;
         
         if (epoll_ctl(_epoll_fd, EPOLL_CTL_ADD, stdout_pipe[0], &event) == -1) {
             Logger::logMsg(RED, CONSOLE_OUTPUT, "Failed to add CGI pipe to epoll");
-            delete cgiProcess;
+            if (cgiProcess->stdin_fd != -1) {
+                closeCgiStdin(cgiProcess->stdin_fd);
+            }
+            releaseContext(stdout_pipe[0]);
             close(stdout_pipe[0]);
-            kill(pid, SIGTERM);
+            kill(pid, SIGKILL);
+            watchCgiExit(pid, NULL);  // Récupérer le processus tué
+            delete cgiProcess;
             sendErrorResponse(client_fd, 500, server);
             return;
         }
         
+        // Fin du processus notifiée par epoll (pidfd)
+        cgiProcess->pidfd = watchCgiExit(pid, cgiProcess);
+        
         // Register CGI process
-        _cgiProcesses[stdout_pipe[0]] = cgiProcess;
-        _cgiToClient[stdout_pipe[0]] = client_fd;
+        ++_cgiCount;
+        timeoutManager.setClientTimeout(stdout_pipe[0], CGI_TIMEOUT);
+        FdContext* client = getClient(client_fd);
+        if (client) {
+            client->cgiFds.push_back(stdout_pipe[0]);
+        }
+        
+        // La réponse arrivera plus tard : réserver sa place dans la file du client
+        cgiProcess->slot = _currentSlot;
+        if (_currentSlot) {
+            _currentSlot->deferred = true;
+            _currentSlot->keepAlive = client && client->keepAlive.keepAlive;
+        }
         
         Logger::logMsg(GREEN, CONSOLE_OUTPUT, "CGI process started with PID %d, pipe fd %d", pid, stdout_pipe[0]);
     }
@@ -1787,15 +2421,14 @@ void EpollClasse::handleCgiRequest(int client_fd, const std::string &scriptPath,
 
 // Gestion de la sortie CGI
 void EpollClasse::handleCgiOutput(int cgi_fd) {
-    std::map<int, CgiProcess*>::iterator it = _cgiProcesses.find(cgi_fd);
-    if (it == _cgiProcesses.end()) {
+    FdContext* cgiCtx = getContext(cgi_fd);
+    if (!cgiCtx || cgiCtx->role != FD_CGI_OUTPUT) {
         Logger::logMsg(YELLOW, CONSOLE_OUTPUT, "CGI process not found for fd %d", cgi_fd);
         return;
     }
     
-    CgiProcess* process = it->second;
+    CgiProcess* process = cgiCtx->cgi;
     char buffer[BUFFER_SIZE];
-    bool dataReceived = false;
     
     // For edge-triggered mode, read all available data
     ssize_t bytesRead;
@@ -1805,32 +2438,110 @@ void EpollClasse::handleCgiOutput(int cgi_fd) {
             process->output.reserve(process->output.size() + bytesRead + BUFFER_SIZE * 4);
         }
         process->output.append(buffer, bytesRead);
-        dataReceived = true;
     }
     
     if (bytesRead < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
         return;
     }
     
-    // CGI process finished (bytesRead == 0) or error occurred
-    Logger::logMsg(GREEN, CONSOLE_OUTPUT, "CGI process finished, total output: %zu bytes", process->output.length());
+    // EOF (bytesRead == 0) or error: la sortie du CGI est complète
+    Logger::logMsg(GREEN, CONSOLE_OUTPUT, "CGI output closed, total output: %zu bytes", process->output.length());
     
     // Additional debugging for large responses
     if (process->output.length() > 50000000) { // 50MB+
         Logger::logMsg(YELLOW, CONSOLE_OUTPUT, "Large CGI response detected: %zu bytes", process->output.length());
     }
     
+    // Plus rien à lire : retirer le pipe d'epoll (sinon HUP en boucle en level-triggered)
+    process->outputDone = true;
+    epoll_ctl(_epoll_fd, EPOLL_CTL_DEL, cgi_fd, NULL);
+    if (process->pidfd == -1) {
+        process->finished = true; // Sans pidfd, pas de notification de fin : l'EOF fait foi
+    }
+    if (!process->finished) {
+        // stdout fermé mais processus encore vivant : attendre son pidfd (ou CGI_TIMEOUT)
+        return;
+    }
+    finishCgiResponse(cgi_fd);
+}
+
+// Surveiller la fin d'un CGI via pidfd ; process == NULL : processus abandonné, seulement à récupérer
+int EpollClasse::watchCgiExit(pid_t pid, CgiProcess* process) {
+    if (!_pidfdSupported) {
+        return -1; // SIGCHLD ignoré : le noyau récupère les processus tout seul
+    }
+    int pid_fd = static_cast<int>(syscall(SYS_pidfd_open, pid, 0)); // O_CLOEXEC par défaut
+    if (pid_fd == -1) {
+        Logger::logMsg(RED, CONSOLE_OUTPUT, "pidfd_open failed for CGI %d: %s", pid, strerror(errno));
+        return -1;
+    }
+    FdContext* pidCtx = acquireContext(pid_fd, FD_CGI_PID);
+    pidCtx->pid = pid;
+    pidCtx->cgi = process;
+    epoll_event event;
+    event.events = EPOLLIN; // Lisible une seule fois, à la fin du processus : pas besoin d'EPOLLET
+    event.data.ptr = pidCtx;
+    if (epoll_ctl(_epoll_fd, EPOLL_CTL_ADD, pid_fd, &event) == -1) {
+        Logger::logMsg(RED, CONSOLE_OUTPUT, "Failed to add CGI pidfd to epoll");
+        releaseContext(pid_fd);
+        close(pid_fd);
+        return -1;
+    }
+    return pid_fd;
+}
+
+// Fin d'un CGI (pidfd lisible) : récupérer son code de sortie sans bloquer ni boucler
+void EpollClasse::handleCgiExit(int pid_fd) {
+    FdContext* pidCtx = getContext(pid_fd);
+    if (!pidCtx || pidCtx->role != FD_CGI_PID) {
+        return;
+    }
+    
+    int status = 0;
+    pid_t result = waitpid(pidCtx->pid, &status, WNOHANG);
+    if (result == 0) {
+        return; // Pas encore terminé
+    }
+    
+    CgiProcess* process = pidCtx->cgi;
+    epoll_ctl(_epoll_fd, EPOLL_CTL_DEL, pid_fd, NULL);
+    releaseContext(pid_fd);
+    close(pid_fd);
+    if (!process) {
+        return; // CGI déjà abandonné (client fermé, timeout) : il ne restait qu'à le récupérer
+    }
+    
+    process->pidfd = -1;
+    process->finished = true;
+    if (result > 0 && WIFSIGNALED(status)) {
+        Logger::logMsg(RED, CONSOLE_OUTPUT, "CGI process %d killed by signal %d", process->pid, WTERMSIG(status));
+        process->exit_status = -1;
+    } else {
+        process->exit_status = (result > 0 && WIFEXITED(status)) ? WEXITSTATUS(status) : 0;
+    }
+    Logger::logMsg(GREEN, CONSOLE_OUTPUT, "CGI process %d exited with status %d", process->pid, process->exit_status);
+    
+    // Le reste de la sortie peut encore être dans le pipe : la réponse part à l'EOF
+    if (process->outputDone) {
+        finishCgiResponse(process->pipe_fd);
+    }
+}
+
+// Sortie complète et processus terminé : construire la réponse à partir de la sortie du CGI
+void EpollClasse::finishCgiResponse(int cgi_fd) {
+    FdContext* cgiCtx = getContext(cgi_fd);
+    if (!cgiCtx || cgiCtx->role != FD_CGI_OUTPUT) {
+        return;
+    }
+    CgiProcess* process = cgiCtx->cgi;
+    
     // Find the corresponding client
-    std::map<int, int>::iterator clientIt = _cgiToClient.find(cgi_fd);
-    if (clientIt != _cgiToClient.end()) {
-        int client_fd = clientIt->second;
+    if (getClient(cgiCtx->clientFd)) {
+        int client_fd = cgiCtx->clientFd;
+        SlotScope scope(_currentSlot, process->slot);
         
-        // Check for the child process completion (non-blocking)
-        int status;
-        pid_t result = waitpid(process->pid, &status, WNOHANG);
-        
-        // Check for immediate failure: no output and process finished
-        if (bytesRead == 0 && process->output.empty()) {
+        // Check for immediate failure: no output
+        if (process->output.empty()) {
             // CGI process produced no output - this usually indicates an error
             Logger::logMsg(RED, CONSOLE_OUTPUT, "CGI process produced no output, sending 500 error");
             
@@ -1847,73 +2558,21 @@ void EpollClasse::handleCgiOutput(int cgi_fd) {
             return;
         }
         
-        if (result > 0) {
-            // Process completed
-            process->finished = true;
-            process->exit_status = WIFEXITED(status) ? WEXITSTATUS(status) : -1;
-            if (WIFEXITED(status) && WEXITSTATUS(status) != 0) {
-                Logger::logMsg(YELLOW, CONSOLE_OUTPUT, "CGI process exited with status %d", WEXITSTATUS(status));
-                // CGI process failed - send 500 error
-                Logger::logMsg(RED, CONSOLE_OUTPUT, "CGI process failed with exit code %d, sending 500 error", WEXITSTATUS(status));
-                
-                // Use stored server config for error response
-                if (process->server_config) {
-                    const Server* serverConfig = static_cast<const Server*>(process->server_config);
-                    sendErrorResponse(client_fd, 500, *serverConfig);
-                } else {
-                    // Fallback: use first available server config
-                    const Server& serverConfig = _serverConfigs->empty() ? Server() : (*_serverConfigs)[0];
-                    sendErrorResponse(client_fd, 500, serverConfig);
-                }
-                cleanupCgiProcess(cgi_fd);
-                return;
-            }
-            if (WIFSIGNALED(status)) {
-                Logger::logMsg(RED, CONSOLE_OUTPUT, "CGI process killed by signal %d, sending 500 error", WTERMSIG(status));
-                
-                // Use stored server config for error response
-                if (process->server_config) {
-                    const Server* serverConfig = static_cast<const Server*>(process->server_config);
-                    sendErrorResponse(client_fd, 500, *serverConfig);
-                } else {
-                    // Fallback: use first available server config
-                    const Server& serverConfig = _serverConfigs->empty() ? Server() : (*_serverConfigs)[0];
-                    sendErrorResponse(client_fd, 500, serverConfig);
-                }
-                cleanupCgiProcess(cgi_fd);
-                return;
-            }
-        } else if (result == 0) {
-            // Process still running, check for timeout
-            time_t current_time = time(NULL);
-            time_t runtime = current_time - process->start_time;
-            
-            // CGI timeout (default 30 seconds)
-            const int CGI_TIMEOUT = 30;
-            if (runtime > CGI_TIMEOUT) {
-                Logger::logMsg(RED, CONSOLE_OUTPUT, "CGI process timeout (%d seconds), killing and sending 500 error", CGI_TIMEOUT);
-                
-                // Kill the CGI process
-                kill(process->pid, SIGKILL);
-                
-                // Use stored server config for error response
-                if (process->server_config) {
-                    const Server* serverConfig = static_cast<const Server*>(process->server_config);
-                    sendErrorResponse(client_fd, 500, *serverConfig);
-                } else {
-                    // Fallback: use first available server config
-                    const Server& serverConfig = _serverConfigs->empty() ? Server() : (*_serverConfigs)[0];
-                    sendErrorResponse(client_fd, 500, serverConfig);
-                }
-                cleanupCgiProcess(cgi_fd);
-                return;
-            }
+        if (process->exit_status != 0) {
+            // CGI process failed (exit code or signal) - send 500 error
+            Logger::logMsg(RED, CONSOLE_OUTPUT, "CGI process failed with exit code %d, sending 500 error", process->exit_status);
             
-            // Process still running, check if we have EOF on pipe
-            if (bytesRead == 0) {
-                // EOF received but process still running, continue monitoring
-                return;
+            // Use stored server config for error response
+            if (process->server_config) {
+                const Server* serverConfig = static_cast<const Server*>(process->server_config);
+                sendErrorResponse(client_fd, 500, *serverConfig);
+            } else {
+                // Fallback: use first available server config
+                const Server& serverConfig = _serverConfigs->empty() ? Server() : (*_serverConfigs)[0];
+                sendErrorResponse(client_fd, 500, serverConfig);
             }
+            cleanupCgiProcess(cgi_fd);
+            return;
         }
         
         // Stream processing - parse headers without copying the entire output
@@ -2025,7 +2684,7 @@ void EpollClasse::handleCgiOutput(int cgi_fd) {
             httpResponse += "Content-Length: " + sizeToString(cgiOutput.length()) + "\r\n";
         }
         
-        httpResponse += "Connection: close\r\n\r\n";
+        httpResponse += "\r\n";
         
         // Append body directly without copying
         if (bodyStart < cgiOutput.length()) {
@@ -2047,293 +2706,513 @@ void EpollClasse::handleCgiOutput(int cgi_fd) {
 
 // Nettoyage du processus CGI
 void EpollClasse::cleanupCgiProcess(int cgi_fd) {
-    std::map<int, CgiProcess*>::iterator it = _cgiProcesses.find(cgi_fd);
-    if (it != _cgiProcesses.end()) {
-        CgiProcess* process = it->second;
+    FdContext* cgiCtx = getContext(cgi_fd);
+    if (cgiCtx && cgiCtx->role == FD_CGI_OUTPUT) {
+        CgiProcess* process = cgiCtx->cgi;
         
         Logger::logMsg(GREEN, CONSOLE_OUTPUT, "Cleaning up CGI process with PID %d", process->pid);
         
+        // Détacher le CGI de son client
+        FdContext* client = getClient(cgiCtx->clientFd);
+        if (client) {
+            std::vector<int>::iterator cgiIt = std::find(client->cgiFds.begin(), client->cgiFds.end(), cgi_fd);
+            if (cgiIt != client->cgiFds.end()) {
+                client->cgiFds.erase(cgiIt);
+            }
+        }
+        
+        // Corps pas encore entièrement écrit : le stdin ne doit pas survivre au processus
+        if (process->stdin_fd != -1) {
+            closeCgiStdin(process->stdin_fd);
+        }
+        
         // Remove from epoll first
         epoll_ctl(_epoll_fd, EPOLL_CTL_DEL, cgi_fd, NULL);
+        timeoutManager.removeClient(cgi_fd);
+        releaseContext(cgi_fd);
         
         // Close the pipe
         close(cgi_fd);
         
-        // Try to terminate the process gracefully, then forcefully if needed
-        if (process->pid > 0) {
-            int status;
-            pid_t result = waitpid(process->pid, &status, WNOHANG);
-            
-            if (result == 0) {
-                // Process still running, try to terminate
-                kill(process->pid, SIGTERM);
-                // Give it a chance to terminate gracefully
-                for (int i = 0; i < 10; ++i) {
-                    result = waitpid(process->pid, &status, WNOHANG);
-                    if (result != 0) break;
-                    // Short non-blocking check, don't use usleep
-                }
-                
-                if (result == 0) {
-                    // Still running, force kill
-                    Logger::logMsg(YELLOW, CONSOLE_OUTPUT, "Force killing CGI process %d", process->pid);
-                    kill(process->pid, SIGKILL);
-                    // Try non-blocking wait, if it fails the signal handler will clean it up
-                    waitpid(process->pid, &status, WNOHANG);
-                }
-            }
-            
-            if (result > 0) {
-                Logger::logMsg(GREEN, CONSOLE_OUTPUT, "CGI process %d terminated with status %d", 
-                              process->pid, WIFEXITED(status) ? WEXITSTATUS(status) : -1);
-            }
+        // Processus encore vivant : le tuer ; son pidfd reste dans epoll pour le récupérer
+        // dès sa fin (handleCgiExit), sans attente active ni zombie
+        if (process->pid > 0 && !process->finished) {
+            Logger::logMsg(YELLOW, CONSOLE_OUTPUT, "Killing CGI process %d", process->pid);
+            kill(process->pid, SIGKILL);
+        }
+        FdContext* pidCtx = getContext(process->pidfd);
+        if (pidCtx && pidCtx->role == FD_CGI_PID) {
+            pidCtx->cgi = NULL;
         }
         
         delete process;
-        _cgiProcesses.erase(it);
+        --_cgiCount;
     }
-    
-    // Remove the CGI->client mapping
-    std::map<int, int>::iterator clientIt = _cgiToClient.find(cgi_fd);
-    if (clientIt != _cgiToClient.end()) {
-        _cgiToClient.erase(clientIt);
+}
+
+// Fermer le stdin d'un CGI (corps écrit, erreur d'écriture ou nettoyage du processus)
+void EpollClasse::closeCgiStdin(int stdin_fd) {
+    FdContext* stdinCtx = getContext(stdin_fd);
+    if (stdinCtx && stdinCtx->role == FD_CGI_INPUT) {
+        stdinCtx->cgi->stdin_fd = -1;
     }
+    epoll_ctl(_epoll_fd, EPOLL_CTL_DEL, stdin_fd, NULL);
+    releaseContext(stdin_fd);
+    close(stdin_fd);
 }
 
 // Handle writing request body to CGI stdin
 void EpollClasse::handleCgiStdinWrite(int stdin_fd) {
-    // Find the CGI process by stdin_fd
-    CgiProcess* cgiProcess = NULL;
-    for (std::map<int, CgiProcess*>::iterator it = _cgiProcesses.begin(); 
-         it != _cgiProcesses.end(); ++it) {
-        if (it->second->stdin_fd == stdin_fd) {
-            cgiProcess = it->second;
-            break;
-        }
-    }
+    FdContext* stdinCtx = getContext(stdin_fd);
+    CgiProcess* cgiProcess = (stdinCtx && stdinCtx->role == FD_CGI_INPUT) ? stdinCtx->cgi : NULL;
     
     if (!cgiProcess) {
         Logger::logMsg(YELLOW, CONSOLE_OUTPUT, "CGI process not found for stdin fd %d", stdin_fd);
         return;
     }
     
-    if (cgiProcess->input_written >= cgiProcess->input_body.length()) {
-        // All data written, close stdin and remove from epoll
-        epoll_ctl(_epoll_fd, EPOLL_CTL_DEL, stdin_fd, NULL);
-        close(stdin_fd);
-        cgiProcess->stdin_fd = -1;
-        return;
-    }
-    
-    // Write chunk of data
-    size_t remaining = cgiProcess->input_body.length() - cgiProcess->input_written;
-    size_t chunkSize = (remaining > 8192) ? 8192 : remaining;
-    
-    ssize_t written = write(stdin_fd, 
-                           cgiProcess->input_body.c_str() + cgiProcess->input_written, 
-                           chunkSize);
-    
-    if (written > 0) {
-        cgiProcess->input_written += written;
-    } else if (written < 0) {
-        if (errno != EAGAIN && errno != EWOULDBLOCK) {
+    // Write chunks until the pipe is full (EAGAIN) : en edge-triggered, aucun autre front ne viendrait
+    while (cgiProcess->input_written < cgiProcess->input_body.length()) {
+        size_t remaining = cgiProcess->input_body.length() - cgiProcess->input_written;
+        size_t chunkSize = (remaining > 8192) ? 8192 : remaining;
+        
+        ssize_t written = write(stdin_fd, 
+                               cgiProcess->input_body.c_str() + cgiProcess->input_written, 
+                               chunkSize);
+        
+        if (written > 0) {
+            cgiProcess->input_written += written;
+        } else if (written < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            return; // Pipe plein : attendre le prochain EPOLLOUT
+        } else {
             Logger::logMsg(RED, CONSOLE_OUTPUT, "Error writing to CGI stdin: %s", strerror(errno));
-            epoll_ctl(_epoll_fd, EPOLL_CTL_DEL, stdin_fd, NULL);
-            close(stdin_fd);
-            cgiProcess->stdin_fd = -1;
+            break;
         }
     }
+    
+    // All data written (or write error), close stdin and remove from epoll
+    closeCgiStdin(stdin_fd);
 }
 
 // Check if fd is a CGI stdin file descriptor
 bool EpollClasse::isCgiStdinFd(int fd) {
-    for (std::map<int, CgiProcess*>::iterator it = _cgiProcesses.begin(); 
-         it != _cgiProcesses.end(); ++it) {
-        if (it->second->stdin_fd == fd) {
-            return true;
+    FdContext* ctx = getContext(fd);
+    return ctx && ctx->role == FD_CGI_INPUT;
+}
+
+// Queue response for non-blocking sending with move optimization
+void EpollClasse::queueResponse(int client_fd, const std::string& response, int fileFd, off_t fileOffset, off_t fileLength) {
+    ResponseBuffer* buffer = fillResponseSlot(client_fd, response);
+    if (!buffer) {
+        if (fileFd != -1) {
+            close(fileFd);
         }
+        return; // Client déjà fermé : plus personne à qui répondre
     }
-    return false;
+    if (fileFd != -1) {
+        buffer->fileFd = fileFd;
+        buffer->fileOffset = fileOffset;
+        buffer->fileEnd = fileOffset + fileLength;
+    }
+    
+    // Try to send immediately first (only if this response is at the head of the queue)
+    flushResponses(client_fd);
 }
 
-// Queue response for non-blocking sending with move optimization
-void EpollClasse::queueResponse(int client_fd, const std::string& response) {
-    ResponseBuffer* buffer = _responseBuffers[client_fd];
+void EpollClasse::queueSharedResponse(int client_fd, const std::string& head, SharedBuffer* shared, size_t offset,
+                                      size_t length) {
+    ResponseBuffer* buffer = fillResponseSlot(client_fd, head);
     if (!buffer) {
-        buffer = new ResponseBuffer();
-        _responseBuffers[client_fd] = buffer;
+        return;
+    }
+    buffer->shared = shared->retain();
+    buffer->sharedOffset = offset;
+    buffer->sharedLength = length;
+    flushResponses(client_fd);
+}
+
+// Slot de la réponse rempli avec response, complet ; NULL si le client est fermé
+ResponseBuffer* EpollClasse::fillResponseSlot(int client_fd, const std::string& response) {
+    FdContext* client = getClient(client_fd);
+    if (!client) {
+        return NULL;
     }
     
-    // Efficient assignment - avoid copying if buffer is empty
-    if (buffer->data.empty()) {
-        buffer->data = response;
-    } else {
-        // If buffer has data, we need to append - still use efficient append
-        buffer->data.reserve(buffer->data.size() + response.length());
-        buffer->data += response;
+    // Remplir le slot de la requête en cours ; sinon (413, 504...) en ouvrir un en fin de file
+    ResponseBuffer* buffer = _currentSlot;
+    if (!buffer) {
+        buffer = openResponseSlot(client_fd);
     }
     
-    buffer->isComplete = true;
+    // La décision keep-alive a été prise au parsing de la requête (ou à la réservation CGI)
+    if (buffer == _currentSlot && !buffer->deferred) {
+        buffer->keepAlive = client->keepAlive.keepAlive;
+    }
+    if (_draining) {
+        buffer->keepAlive = false; // Réponse (ex: CGI) réservée avant SIGQUIT
+    }
+    std::string connectionHeader = "Connection: close\r\n";
+    if (buffer->keepAlive) {
+        connectionHeader = "Connection: keep-alive\r\nKeep-Alive: timeout="
+                           + sizeToString(client->keepAlive.idleTimeout) + "\r\n";
+    }
     
-    // Try to send immediately first
-    size_t remaining = buffer->data.length() - buffer->sent;
-    if (remaining > 0) {
-        size_t chunkSize = (remaining > 2097152) ? 2097152 : remaining; // Increased to 2MB chunks for maximum performance
-        
-        // Use MSG_MORE for better TCP performance when more data is coming
-        int flags = MSG_NOSIGNAL;
-        if (remaining > chunkSize) {
-            flags |= MSG_MORE; // Tell kernel more data is coming
-        }
+    // Injecter l'en-tête Connection juste après la ligne de statut, en une seule copie
+    size_t statusEnd = response.find("\r\n");
+    buffer->data.reserve(buffer->data.size() + response.length() + connectionHeader.length());
+    if (statusEnd == std::string::npos) {
+        buffer->data += response;
+    } else {
+        buffer->data.append(response, 0, statusEnd + 2);
+        buffer->data += connectionHeader;
+        buffer->data.append(response, statusEnd + 2, std::string::npos);
+    }
+    buffer->isComplete = true;
+    return buffer;
+}
+
+// Reste à envoyer de data et de la réponse partagée, au plus SEND_CHUNK_SIZE octets
+static int pendingIov(const ResponseBuffer& buffer, struct iovec* iov) {
+    size_t room = SEND_CHUNK_SIZE;
+    int iovcnt = 0;
+    size_t sharedSent = 0;
+    if (buffer.sent < buffer.data.length()) {
+        size_t n = buffer.data.length() - buffer.sent;
+        n = (n < room) ? n : room;
+        iov[iovcnt].iov_base = const_cast<char*>(buffer.data.data()) + buffer.sent;
+        iov[iovcnt].iov_len = n;
+        ++iovcnt;
+        room -= n;
+    } else {
+        sharedSent = buffer.sent - buffer.data.length();
+    }
+    if (room > 0 && sharedSent < buffer.sharedLength) {
+        size_t n = buffer.sharedLength - sharedSent;
+        iov[iovcnt].iov_base = const_cast<char*>(buffer.shared->data.data()) + buffer.sharedOffset + sharedSent;
+        iov[iovcnt].iov_len = (n < room) ? n : room;
+        ++iovcnt;
+    }
+    return iovcnt;
+}
+
+// Partie suivante d'une réponse multi-intervalles : ses en-têtes deviennent data
+static bool startNextSegment(ResponseBuffer& buffer) {
+    if (buffer.fileFd == -1 || buffer.nextSegment >= buffer.segments.size()) {
+        return false;
+    }
+    FileSegment& segment = buffer.segments[buffer.nextSegment++];
+    buffer.data.swap(segment.prefix);
+    buffer.sent = 0;
+    buffer.fileOffset = segment.offset;
+    buffer.fileEnd = segment.end;
+    return true;
+}
+
+// Envoi interrompu : attendre EPOLLOUT ; en edge-triggered, budget épuisé sur un socket
+// encore inscriptible, reprendre au tour suivant (epoll ne le signalera plus)
+void EpollClasse::suspendFlush(int client_fd, bool budgetExhausted) {
+    updateClientDeadline(client_fd);
+    if (budgetExhausted && _edgeTriggered) {
+        markPending(client_fd, EPOLLOUT);
+        return;
+    }
+    addClientToEpollOut(client_fd);
+}
+
+// Handle non-blocking client writing
+void EpollClasse::handleClientWrite(int client_fd) {
+    flushResponses(client_fd);
+}
+
+// Réserver la place de la prochaine réponse dans la file du client
+ResponseBuffer* EpollClasse::openResponseSlot(int client_fd) {
+    ResponseBuffer* slot = new ResponseBuffer();
+    _fdTable[client_fd]->responses.push_back(slot);
+    return slot;
+}
+
+// Envoyer les réponses prêtes en tête de file, dans l'ordre des requêtes
+void EpollClasse::flushResponses(int client_fd) {
+    FdContext* client = getClient(client_fd);
+    if (!client) {
+        return;
+    }
+    std::deque<ResponseBuffer*>& queue = client->responses;
+    
+    // Level-triggered : un send par réveil ; edge-triggered : jusqu'à EAGAIN (dans la limite du budget)
+    int sendBudget = _edgeTriggered ? MAX_IO_PER_EVENT : 1;
+    
+    while (!queue.empty() && queue.front()->isComplete) {
+        ResponseBuffer* buffer = queue.front();
+        // multipart/byteranges : chaque partie (en-têtes puis tranche) repasse par ces deux envois
+        do {
+            while (buffer->sent < buffer->length()) {
+                // data puis la réponse partagée : un seul appel pour les deux
+                struct iovec iov[2];
+                int iovcnt = pendingIov(*buffer, iov);
+                size_t remaining = buffer->length() - buffer->sent;
+                size_t chunkSize = iov[0].iov_len + ((iovcnt > 1) ? iov[1].iov_len : 0);
+            
+                // Use MSG_MORE for better TCP performance when more data is coming
+                int flags = MSG_NOSIGNAL;
+                if (remaining > chunkSize || buffer->hasFileBody()) {
+                    flags |= MSG_MORE; // Tell kernel more data is coming - improves TCP efficiency
+                }
+            
+                struct msghdr msg;
+                memset(&msg, 0, sizeof(msg));
+                msg.msg_iov = iov;
+                msg.msg_iovlen = iovcnt;
+                ssize_t sent = sendmsg(client_fd, &msg, flags);
+                if (sent < 0 && errno != EAGAIN && errno != EWOULDBLOCK) {
+                    Logger::logMsg(RED, CONSOLE_OUTPUT, "Error sending to client %d: %s", client_fd, strerror(errno));
+                    closeClient(client_fd);
+                    return;
+                }
+                if (sent > 0) {
+                    buffer->sent += sent;
+                    client->timers.bytesSent += sent;
+                }
+                if (buffer->sent == buffer->length()) {
+                    break;
+                }
+                if (sent < 0 || --sendBudget <= 0) {
+                    suspendFlush(client_fd, sent > 0);
+                    return;
+                }
+            }
         
-        ssize_t sent = send(client_fd, buffer->data.c_str() + buffer->sent, chunkSize, flags);
+            // Corps de fichier : du page cache au socket (sendfile avance fileOffset)
+            while (buffer->fileFd != -1 && buffer->fileOffset < buffer->fileEnd) {
+                off_t remaining = buffer->fileEnd - buffer->fileOffset;
+                size_t chunkSize = (remaining > SEND_CHUNK_SIZE) ? SEND_CHUNK_SIZE : static_cast<size_t>(remaining);
+                ssize_t sent = sendfile(client_fd, buffer->fileFd, &buffer->fileOffset, chunkSize);
+                if ((sent < 0 && errno != EAGAIN && errno != EWOULDBLOCK) || sent == 0) {
+                    // sent == 0 : fichier tronqué depuis l'envoi des en-têtes, Content-Length intenable
+                    Logger::logMsg(RED, CONSOLE_OUTPUT, "Error sending file to client %d: %s", client_fd,
+                                   (sent == 0) ? "file truncated" : strerror(errno));
+                    closeClient(client_fd);
+                    return;
+                }
+                if (sent > 0) {
+                    client->timers.bytesSent += sent;
+                }
+                if (buffer->fileOffset >= buffer->fileEnd) {
+                    break;
+                }
+                if (sent < 0 || --sendBudget <= 0) {
+                    suspendFlush(client_fd, sent > 0);
+                    return;
+                }
+            }
+        } while (startNextSegment(*buffer));
         
-        if (sent > 0) {
-            buffer->sent += sent;
+        Logger::logMsg(GREEN, CONSOLE_OUTPUT, "Sent complete response to client %d (%zu bytes%s)", 
+                      client_fd, buffer->sent, (buffer->fileFd != -1) ? " + file" : "");
+        if (!buffer->keepAlive) {
+            if (client->keepAlive.closing) {
+                lingerClose(client_fd); // Erreur : le client envoie peut-être encore
+            } else {
+                closeClient(client_fd);
+            }
+            return;
         }
-        
-        // If we couldn't send everything, add to epoll for writing
-        if (buffer->sent < buffer->data.length()) {
-            addClientToEpollOut(client_fd);
-        } else {
-            // All data sent immediately, close connection
-            Logger::logMsg(GREEN, CONSOLE_OUTPUT, "Sent complete response to client %d (%zu bytes)", 
-                          client_fd, buffer->sent);
-            
-            // Close client connection
-            epoll_ctl(_epoll_fd, EPOLL_CTL_DEL, client_fd, NULL);
-            timeoutManager.removeClient(client_fd);
-            _bufferManager.clear(client_fd);
-            cleanupClientResponse(client_fd);
-            close(client_fd);
+        if (buffer == _currentSlot) {
+            _currentSlot = NULL;
         }
+        delete buffer;
+        queue.pop_front();
     }
+    
+    // Plus rien d'envoyable : file vide, ou tête de file en attente d'un CGI
+    removeClientFromEpollOut(client_fd);
+    if (queue.empty()) {
+        if (_bufferManager.getBufferSize(client_fd) == 0) {
+            if (_draining) {
+                closeClient(client_fd); // Arrêt gracieux : plus de keep-alive
+                return;
+            }
+        }
+        // Reprendre les requêtes pipelinées suspendues par MAX_PIPELINED_REQUESTS
+        processBufferedRequests(client_fd);
+    }
+    // Connexion inactive : keepalive_timeout ; tête de file en attente d'un CGI : send_timeout
+    updateClientDeadline(client_fd);
 }
 
-// Handle non-blocking client writing
-void EpollClasse::handleClientWrite(int client_fd) {
-    std::map<int, ResponseBuffer*>::iterator bufferIt = _responseBuffers.find(client_fd);
-    if (bufferIt == _responseBuffers.end()) {
-        // No buffer found, remove from epoll out
-        removeClientFromEpollOut(client_fd);
+// Réponse d'erreur envoyée alors que le client envoie peut-être encore (corps refusé
+// par 413/417...) : un close() avec des octets non lus ferait partir un RST, qui peut
+// détruire la réponse chez le client avant qu'il la lise. L'écriture est fermée, puis
+// la lecture est jetée jusqu'à la fin du client ou l'échéance de PHASE_LINGER.
+void EpollClasse::lingerClose(int client_fd) {
+    FdContext* client = getClient(client_fd);
+    if (!client) {
         return;
     }
-    
-    ResponseBuffer* buffer = bufferIt->second;
-    
-    // Regular response handling
-    if (buffer->sent >= buffer->data.length()) {
-        // All data sent, clean up and close connection
-        Logger::logMsg(GREEN, CONSOLE_OUTPUT, "Sent complete response to client %d (%zu bytes)", 
-                      client_fd, buffer->sent);
-        
-        // Close client connection
-        epoll_ctl(_epoll_fd, EPOLL_CTL_DEL, client_fd, NULL);
-        timeoutManager.removeClient(client_fd);
-        _bufferManager.clear(client_fd);
-        cleanupClientResponse(client_fd);
-        close(client_fd);
+    std::vector<int> orphanCgi;
+    orphanCgi.swap(client->cgiFds);
+    for (std::vector<int>::iterator it = orphanCgi.begin(); it != orphanCgi.end(); ++it) {
+        cleanupCgiProcess(*it);
+    }
+    removeClientFromEpollOut(client_fd);
+    _bufferManager.clear(client_fd);
+    cleanupClientResponse(client_fd);
+    if (shutdown(client_fd, SHUT_WR) == -1) {
+        closeClient(client_fd);
         return;
     }
+    client->lingering = true;
+    discardLingeringInput(client_fd); // En edge-triggered, les octets déjà là ne seront pas signalés
+}
+
+void EpollClasse::discardLingeringInput(int client_fd) {
+    FdContext* client = getClient(client_fd);
+    if (!client) {
+        return;
+    }
+    char discard[BUFFER_CHUNK_SIZE];
+    int readBudget = _edgeTriggered ? MAX_IO_PER_EVENT : 1;
+    for (int reads = 0; reads < readBudget; ++reads) {
+        ssize_t bytes = recv(client_fd, discard, sizeof(discard), 0);
+        if (bytes > 0) {
+            client->timers.bytesRead += bytes;
+            continue;
+        }
+        if (bytes == -1 && errno == EINTR) {
+            continue;
+        }
+        if (bytes == -1 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            updateClientDeadline(client_fd);
+            return;
+        }
+        closeClient(client_fd); // Fin du client (ou erreur) : plus rien à attendre
+        return;
+    }
+    if (_edgeTriggered) {
+        markPending(client_fd, EPOLLIN);
+    }
+    updateClientDeadline(client_fd);
+}
+
+// Fermer une connexion client et libérer tout son état
+void EpollClasse::closeClient(int client_fd) {
+    FdContext* client = getClient(client_fd);
+    if (!client) {
+        return; // Déjà fermé
+    }
     
-    // Send as much data as possible - use larger chunks for better throughput
-    size_t remaining = buffer->data.length() - buffer->sent;
-    size_t chunkSize = (remaining > 2097152) ? 2097152 : remaining; // Increased to 2MB chunks for maximum performance
-    
-    // Use MSG_MORE for better TCP performance when more data is coming
-    int flags = MSG_NOSIGNAL;
-    if (remaining > chunkSize) {
-        flags |= MSG_MORE; // Tell kernel more data is coming - improves TCP efficiency
+    // Les CGI encore rattachés à ce client n'ont plus de destinataire
+    std::vector<int> orphanCgi;
+    orphanCgi.swap(client->cgiFds);
+    for (std::vector<int>::iterator it = orphanCgi.begin(); it != orphanCgi.end(); ++it) {
+        cleanupCgiProcess(*it);
     }
     
-    ssize_t sent = send(client_fd, buffer->data.c_str() + buffer->sent, chunkSize, flags);
+    epoll_ctl(_epoll_fd, EPOLL_CTL_DEL, client_fd, NULL);
+    timeoutManager.removeClient(client_fd);
+    _bufferManager.clear(client_fd);
+    cleanupClientResponse(client_fd);
+    releaseContext(client_fd);
+    close(client_fd);
     
-    if (sent > 0) {
-        buffer->sent += sent;
-    } else if (sent < 0) {
-        if (errno == EAGAIN || errno == EWOULDBLOCK) {
-            // Would block, will try again when epoll signals ready
-            return;
-        } else {
-            // Error occurred, close connection
-            Logger::logMsg(RED, CONSOLE_OUTPUT, "Error sending to client %d: %s", client_fd, strerror(errno));
-            epoll_ctl(_epoll_fd, EPOLL_CTL_DEL, client_fd, NULL);
-            timeoutManager.removeClient(client_fd);
-            _bufferManager.clear(client_fd);
-            cleanupClientResponse(client_fd);
-            close(client_fd);
-        }
+    _clientCount--;
+    if (_reserveFd == -1) {
+        _reserveFd = open("/dev/null", O_RDONLY | O_CLOEXEC);
+    }
+    if (_listenersPaused && _clientCount < _maxClients) {
+        resumeListeners();
+    }
+}
+
+// HTTP/1.1 : persistant sauf "Connection: close" ; HTTP/1.0 : fermé sauf "Connection: keep-alive"
+bool EpollClasse::wantsKeepAlive(const std::string &protocol, const HttpRequest &request) {
+    std::string connection = request.getHeader(HDR_CONNECTION);
+    for (size_t i = 0; i < connection.length(); ++i) {
+        connection[i] = tolower(connection[i]);
     }
+    
+    if (connection.find("close") != std::string::npos) {
+        return false;
+    }
+    if (protocol == "HTTP/1.0") {
+        return connection.find("keep-alive") != std::string::npos;
+    }
+    return true;
 }
 
 // Add client to epoll for writing
 void EpollClasse::addClientToEpollOut(int client_fd) {
-    if (_clientsInEpollOut.find(client_fd) != _clientsInEpollOut.end()) {
+    FdContext* client = getClient(client_fd);
+    if (!client || client->inEpollOut) {
         return; // Already added
     }
     
     epoll_event event;
-    event.events = EPOLLIN | EPOLLOUT; // Level-triggered for both read and write
-    event.data.fd = client_fd;
+    event.events = eventMask(EPOLLIN | EPOLLOUT);
+    event.data.ptr = client;
     
     if (epoll_ctl(_epoll_fd, EPOLL_CTL_MOD, client_fd, &event) == -1) {
         Logger::logMsg(RED, CONSOLE_OUTPUT, "Failed to modify client %d to epoll for writing: %s", client_fd, strerror(errno));
         return;
     }
     
-    _clientsInEpollOut[client_fd] = true;
+    client->inEpollOut = true;
 }
 
 // Remove client from epoll writing
 void EpollClasse::removeClientFromEpollOut(int client_fd) {
-    std::map<int, bool>::iterator it = _clientsInEpollOut.find(client_fd);
-    if (it == _clientsInEpollOut.end()) {
+    FdContext* client = getClient(client_fd);
+    if (!client || !client->inEpollOut) {
         return; // Not in epoll out
     }
     
     epoll_event event;
-    event.events = EPOLLIN; // Back to read-only mode
-    event.data.fd = client_fd;
+    event.events = eventMask(EPOLLIN); // Back to read-only mode
+    event.data.ptr = client;
     
     epoll_ctl(_epoll_fd, EPOLL_CTL_MOD, client_fd, &event);
-    _clientsInEpollOut.erase(it);
+    client->inEpollOut = false;
 }
 
 // Clean up client response buffer
 void EpollClasse::cleanupClientResponse(int client_fd) {
-    std::map<int, ResponseBuffer*>::iterator bufferIt = _responseBuffers.find(client_fd);
-    if (bufferIt != _responseBuffers.end()) {
-        delete bufferIt->second;
-        _responseBuffers.erase(bufferIt);
+    FdContext* client = getClient(client_fd);
+    if (!client) {
+        return;
     }
-    
-    std::map<int, bool>::iterator epollIt = _clientsInEpollOut.find(client_fd);
-    if (epollIt != _clientsInEpollOut.end()) {
-        _clientsInEpollOut.erase(epollIt);
+    for (std::deque<ResponseBuffer*>::iterator it = client->responses.begin(); it != client->responses.end(); ++it) {
+        if (*it == _currentSlot) {
+            _currentSlot = NULL;
+        }
+        delete *it;
     }
+    client->responses.clear();
+    client->inEpollOut = false;
 }
 
 // ============================================================================
 // Cookie Management Implementation
 // ============================================================================
 
-void EpollClasse::parseCookiesFromRequest(int client_fd, const std::map<std::string, std::string> &headers) {
-    std::map<std::string, std::string>::const_iterator cookieIt = headers.find("Cookie");
-    if (cookieIt != headers.end()) {
-        if (_clientCookies.find(client_fd) == _clientCookies.end()) {
-            _clientCookies[client_fd] = CookieManager();
-        }
-        _clientCookies[client_fd].parseCookieHeader(cookieIt->second);
+void EpollClasse::parseCookiesFromRequest(int client_fd, const HttpRequest &request) {
+    const HttpHeaderField* cookieField = request.findHeader(HDR_COOKIE);
+    FdContext* client = getClient(client_fd);
+    if (cookieField && client) {
+        std::string cookieHeader = request.str(cookieField->value);
+        client->hasCookies = true;
+        client->cookies.parseCookieHeader(cookieHeader);
         Logger::logMsg(GREEN, CONSOLE_OUTPUT, "Parsed cookies from client %d: %s", 
-                       client_fd, cookieIt->second.c_str());
+                       client_fd, cookieHeader.c_str());
     }
 }
 
 void EpollClasse::addCookieToResponse(int client_fd, const Cookie& cookie) {
-    if (_clientCookies.find(client_fd) == _clientCookies.end()) {
-        _clientCookies[client_fd] = CookieManager();
+    FdContext* client = getClient(client_fd);
+    if (!client) {
+        return;
     }
-    _clientCookies[client_fd].addCookie(cookie);
+    client->hasCookies = true;
+    client->cookies.addCookie(cookie);
     Logger::logMsg(GREEN, CONSOLE_OUTPUT, "Added cookie to client %d: %s=%s", 
                    client_fd, cookie.getName().c_str(), cookie.getValue().c_str());
 }
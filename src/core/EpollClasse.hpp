@@ -7,6 +7,7 @@
 #include <sys/epoll.h>
 #include <netinet/in.h>
 #include <map>
+#include <deque>
 #include <fcntl.h>
 #include <unistd.h>
 #include <sys/socket.h>
@@ -16,14 +17,103 @@
 #include "../serverConfig/ServerConfig.hpp"
 #include "TimeoutManager.hpp"
 #include "../http/Cookie.hpp"
+#include "../http/RequestBufferManager.hpp"
+#include "../http/PathNormalizer.hpp"
+#include "../http/StaticFileCache.hpp"
+#include "../http/ByteRange.hpp"
 
 #define MAX_EVENTS 1024
 #define MAX_CGI_PROCESSES 100
+#define CGI_TIMEOUT 30            // Secondes avant qu'un CGI soit tué (504)
+#define MAX_PIPELINED_REQUESTS 32 // Réponses en attente max par connexion avant de suspendre le parsing
+#define MAX_IO_PER_EVENT 16       // Mode EPOLLET : read/send max par fd et par réveil avant de céder la main
+#define SEND_CHUNK_SIZE 2097152   // Octets max par send/sendfile
+#define STATIC_FADVISE_MIN 1048576 // Fichiers statiques lus de façon séquentielle au-delà (posix_fadvise)
+#define LINGER_TIMEOUT_MS 2000    // Fermeture différée : délai sans octet reçu du client
+#define LINGER_TIME_MS 10000      // Fermeture différée : durée totale max
+#define ACCEPT_RETRY_MS 1000      // Accept suspendu faute de fd : nouvel essai au plus tard après ce délai
 
 // Forward declarations
 struct CgiProcess;
 struct ResponseBuffer;
 
+// Etat persistant d'une connexion client entre deux requêtes (keep-alive)
+struct KeepAliveState {
+    bool keepAlive;      // La requête en cours de traitement laisse la connexion ouverte
+    bool closing;        // Une réponse "Connection: close" est en file : ignorer la suite
+    int requestCount;    // Nombre de requêtes reçues sur cette connexion
+    int idleTimeout;     // keepalive_timeout du serveur qui a répondu
+
+    KeepAliveState() : keepAlive(false), closing(false), requestCount(0), idleTimeout(0) {}
+};
+
+// Phase d'une connexion client : chacune a son délai
+enum ClientPhase {
+    PHASE_HEADER,   // client_header_timeout, depuis le début de la tête
+    PHASE_BODY,     // client_body_timeout sans octet reçu (et min_transfer_rate)
+    PHASE_SEND,     // send_timeout sans octet envoyé (et min_transfer_rate), CGI compris
+    PHASE_IDLE,     // keepalive_timeout entre deux requêtes
+    PHASE_LINGER    // Réponse finale envoyée, écriture fermée : lecture jetée jusqu'à LINGER_*
+};
+
+struct ClientTimers {
+    ClientPhase phase;
+    long long phaseStart;       // ms, horloge de TimeoutManager
+    long long lastProgress;     // Dernier octet reçu ou envoyé pendant la phase
+    size_t bytesRead;           // Cumuls de la connexion
+    size_t bytesSent;
+    size_t phaseBytes;          // Cumul de la phase à son début
+    size_t lastBytes;
+    int headerTimeout;          // Secondes, du serveur par défaut du port
+    int bodyTimeout;            // Secondes, du serveur de la requête en cours
+    int sendTimeout;
+    size_t minRate;             // Octets/s (0 : désactivé)
+
+    ClientTimers() : phase(PHASE_HEADER), phaseStart(0), lastProgress(0), bytesRead(0), bytesSent(0),
+                     phaseBytes(0), lastBytes(0), headerTimeout(60), bodyTimeout(60), sendTimeout(60),
+                     minRate(0) {}
+};
+
+// Rôle d'un fd enregistré dans la boucle
+enum FdRole {
+    FD_UNUSED,
+    FD_LISTENER,
+    FD_CLIENT,
+    FD_CGI_OUTPUT,   // stdout du CGI (possède le CgiProcess)
+    FD_CGI_INPUT,    // stdin du CGI (corps de la requête à écrire)
+    FD_CGI_PID,      // pidfd du processus CGI (lisible à sa fin)
+    FD_SIGNAL,       // Pipe de ProcessControl (SIGQUIT / SIGUSR2)
+    FD_FILE_CACHE    // inotify du cache de fichiers statiques
+};
+
+// Etat d'un fd, rangé dans _fdTable à l'indice fd et transmis par epoll_event.data.ptr.
+// Les objets ne sont jamais libérés avant la boucle : un événement resté dans le lot
+// d'epoll_wait après fermeture du fd trouve simplement role == FD_UNUSED.
+struct FdContext {
+    int fd;
+    FdRole role;
+    uint32_t pendingEvents;                 // Edge-triggered : événements à rejouer au tour suivant
+
+    // FD_CLIENT
+    KeepAliveState keepAlive;
+    ClientTimers timers;
+    std::deque<ResponseBuffer*> responses;  // Une réponse par requête, dans l'ordre des requêtes
+    bool inEpollOut;
+    bool lingering;                         // Fermeture différée en cours (lingerClose)
+    bool hasCookies;
+    CookieManager cookies;
+    int localPort;                          // Port d'écoute, lu une fois à l'accept
+    std::vector<int> cgiFds;                // CGI en cours pour ce client
+
+    // FD_CGI_OUTPUT / FD_CGI_INPUT / FD_CGI_PID
+    CgiProcess* cgi;                        // NULL pour un pidfd dont le CGI a été abandonné
+    int clientFd;
+    pid_t pid;
+
+    FdContext() : fd(-1), role(FD_UNUSED), pendingEvents(0), inEpollOut(false), lingering(false), hasCookies(false),
+                  localPort(0), cgi(NULL), clientFd(-1), pid(-1) {}
+};
+
 class EpollClasse {
 private:
     int _epoll_fd;
@@ -32,49 +122,93 @@ private:
     std::vector<ServerConfig> _servers;
     const std::vector<Server>* _serverConfigs;
     TimeoutManager timeoutManager;
+    RequestBufferManager _bufferManager;   // Requêtes partielles, propres à cette boucle (un par worker)
+    PathNormalizer _paths;                  // Chemins canoniques récents de cette boucle
+    StaticFileCache _fileCache;             // Petits fichiers statiques de cette boucle
     
-    // CGI management
-    std::map<int, CgiProcess*> _cgiProcesses;
-    std::map<int, int> _cgiToClient;
+    // Etat par fd (clients, listeners, pipes CGI), indexé par numéro de fd
+    std::vector<FdContext*> _fdTable;
+    size_t _cgiCount;
     
-    // Response buffering for non-blocking sends
-    std::map<int, ResponseBuffer*> _responseBuffers;
-    std::map<int, bool> _clientsInEpollOut;
+    // Response buffering for non-blocking sends (les files sont dans FdContext)
+    ResponseBuffer* _currentSlot;   // Slot rempli par queueResponse (requête ou CGI en cours)
+    int _processingFd;              // Client dont les requêtes bufferisées sont en cours de traitement
     
-    // Cookie management
-    std::map<int, CookieManager> _clientCookies;  // client_fd -> CookieManager
+    // Mode edge-triggered : fd non drainés jusqu'à EAGAIN (budget épuisé), repris au tour suivant
+    bool _edgeTriggered;
+    std::vector<FdContext*> _pendingContexts;
+    
+    bool _pidfdSupported;   // pidfd_open disponible : fin des CGI notifiée par epoll
+    
+    // Limite de connexions : listeners retirés d'epoll tant que la boucle est pleine
+    size_t _maxClients;
+    size_t _clientCount;
+    bool _listenersPaused;
+    TimeoutManager::msec_t _listenersPausedUntil; // Faute de fd : reprise de l'accept (0 : à la prochaine fermeture)
+    int _reserveFd;         // fd de réserve libéré sur EMFILE pour accepter puis refermer
+    
+    bool _draining;         // SIGQUIT reçu : plus d'accept, sortie de serverRun une fois les clients servis
+    
+    // En-tête Date, reformaté au plus une fois par seconde
+    time_t _dateSecond;
+    std::string _date;
+    unsigned long _boundarySerial;  // Délimiteurs multipart/byteranges distincts
     
     // Méthodes privées
     void setNonBlocking(int fd);
+    uint32_t eventMask(uint32_t events) const;
+    void dispatchEvent(FdContext* ctx, uint32_t events);
+    void markPending(int fd, uint32_t events);
+    void runPendingEvents();
+    void pauseListeners();
+    void resumeListeners();
+    void rejectConnection(int server_fd);
+    void beginDrain();
+    
+    // Table des fd
+    FdContext* acquireContext(int fd, FdRole role);
+    void releaseContext(int fd);
+    FdContext* getContext(int fd);
+    FdContext* getClient(int fd);
     std::string resolvePath(const Server &server, const std::string &requestedPath);
     std::string getMimeType(const std::string &filePath);
+    std::string generateHttpHeaders(int statusCode, const std::string &contentType, size_t contentLength,
+                                   const std::map<std::string, std::string> &headers = std::map<std::string, std::string>());
     std::string generateHttpResponse(int statusCode, const std::string &contentType, 
                                    const std::string &body, const std::map<std::string, std::string> &headers = std::map<std::string, std::string>());
     std::string generateHttpResponseWithCookies(int client_fd, int statusCode, const std::string &contentType, 
                                                const std::string &body, const std::map<std::string, std::string> &headers = std::map<std::string, std::string>());
     
     std::string getStatusCodeString(int statusCode);
-    std::string getCurrentDateTime();
+    const std::string& getCurrentDateTime();
     bool fileExists(const std::string &filePath);
     std::string readFile(const std::string &filePath);
     size_t getFileSize(const std::string &filePath);
     
-    // HTTP request parsing
-    std::map<std::string, std::string> parseHeaders(const std::string &request);
-    std::string parseMethod(const std::string &request);
-    std::string parsePath(const std::string &request);
-    std::string parseQueryString(const std::string &request);
-    std::string parseBody(const std::string &request);
-    std::string decodeChunkedBody(const std::string &chunkedData);
+    // HTTP request parsing (tête et corps analysés à la réception par HttpRequestParser)
+    const Server& serverForRequest(FdContext* client, const HttpRequest &request);
+    size_t maxBodySize(const Server &server, const std::string &path);
+    size_t bodyBufferSize(const Server &server, const std::string &path);
     
     // HTTP methods
     void handleGetRequest(int client_fd, const std::string &path, const Server &server, 
-                         const std::map<std::string, std::string> &headers = std::map<std::string, std::string>(), 
-                         const std::string &queryString = "");
-    void handlePostRequest(int client_fd, const std::string &path, const std::string &body, 
-                          const std::map<std::string, std::string> &headers, const Server &server, const std::string &queryString = "");
+                         const HttpRequest &request, const std::string &queryString = "");
+    void handlePostRequest(int client_fd, const std::string &path, const HttpRequest &request,
+                          const Server &server, const std::string &queryString = "");
     void handleDeleteRequest(int client_fd, const std::string &path, const Server &server);
-    void handleHeadRequest(int client_fd, const std::string &path, const Server &server);
+    void handleHeadRequest(int client_fd, const std::string &path, const Server &server,
+                           const HttpRequest &request);
+    void serveStaticFile(int client_fd, const std::string &filePath, const Server &server,
+                         const HttpRequest &request);
+    void serveFileRanges(int client_fd, const std::string &filePath, int fd, const struct stat &st,
+                         const std::vector<ByteRange> &ranges);
+    bool ifRangeMatches(const HttpRequest &request, const struct stat &st, const std::string &etag);
+    bool serveCachedFile(int client_fd, const std::string &filePath, const Server &server,
+                         const HttpRequest &request, bool headOnly);
+    std::map<std::string, std::string> fileHeaders(const struct stat &st, const std::string &etag);
+    void sendPreconditionResponse(int client_fd, int statusCode, time_t lastModified, const std::string &etag,
+                                  const Server &server);
+    void queueCachedFile(int client_fd, const CachedResponse &cached, bool headOnly);
     
     // Error handling
     void sendErrorResponse(int client_fd, int errorCode, const Server &server);
@@ -83,26 +217,45 @@ private:
     // CGI handling
     void handleCgiRequest(int client_fd, const std::string &scriptPath, const std::string &requestPath, const std::string &method,
                          const std::string &queryString, const std::string &body,
-                         const std::map<std::string, std::string> &headers, const Server &server);
+                         const HttpRequest &request, const Server &server);
     void handleCgiOutput(int cgi_fd);
+    int watchCgiExit(pid_t pid, CgiProcess* process);
+    void handleCgiExit(int pid_fd);
+    void finishCgiResponse(int cgi_fd);
     void handleCgiStdinWrite(int stdin_fd);
     void cleanupCgiProcess(int cgi_fd);
+    void closeCgiStdin(int stdin_fd);
     bool isCgiStdinFd(int fd);
     
     // Response buffering for non-blocking sends
-    void queueResponse(int client_fd, const std::string& response);
+    // fileFd (possédé dès l'appel) : corps envoyé par sendfile après response (les en-têtes)
+    void queueResponse(int client_fd, const std::string& response, int fileFd = -1, off_t fileOffset = 0, off_t fileLength = 0);
+    // head (ligne de statut et en-têtes propres à l'envoi) puis length octets de shared à partir de offset
+    void queueSharedResponse(int client_fd, const std::string& head, SharedBuffer* shared, size_t offset, size_t length);
+    ResponseBuffer* fillResponseSlot(int client_fd, const std::string& response);
+    void suspendFlush(int client_fd, bool budgetExhausted);
     void handleClientWrite(int client_fd);
     void addClientToEpollOut(int client_fd);
     void removeClientFromEpollOut(int client_fd);
     void cleanupClientResponse(int client_fd);
+    ResponseBuffer* openResponseSlot(int client_fd);
+    void flushResponses(int client_fd);
+    void closeClient(int client_fd);
+    void lingerClose(int client_fd);
+    void discardLingeringInput(int client_fd);
+    
+    // Persistent connections
+    bool wantsKeepAlive(const std::string &protocol, const HttpRequest &request);
     
     // File upload handling
-    void handleFileUpload(int client_fd, const std::string &body, 
-                         const std::map<std::string, std::string> &headers, const Server &server);
-    std::map<std::string, std::string> parseMultipartData(const std::string &body, const std::string &boundary);
+    void handleFileUpload(int client_fd, const HttpRequest &request, const Server &server);
+    void prepareUpload(int client_fd, const HttpRequest &request, const Server &server, const std::string &path);
+    std::string uploadDirectory(const Server &server);
+    bool isCgiPath(const Server &server, const std::string &path);
+    bool writeRequestBody(const HttpRequest &request, const std::string &filePath);
     
     // Cookie management
-    void parseCookiesFromRequest(int client_fd, const std::map<std::string, std::string> &headers);
+    void parseCookiesFromRequest(int client_fd, const HttpRequest &request);
     void addCookieToResponse(int client_fd, const Cookie& cookie);
     void cleanupClientCookies(int client_fd);
 
@@ -110,16 +263,31 @@ public:
     EpollClasse();
     ~EpollClasse();
     
+    void setEdgeTriggered(bool enabled);
+    void setConnectionLimit(int maxClients);
+    void setFileCache(size_t budget, size_t maxFileSize, int validSeconds);
     void setupServers(std::vector<ServerConfig> servers, const std::vector<Server> &serverConfigs);
+    void watchSignals(bool handleUpgrade);
     void serverRun();
     void addToEpoll(int fd, epoll_event &event);
     
     // Event handlers
     void acceptConnection(int server_fd);
     void handleRequest(int client_fd);
+    void processBufferedRequests(int client_fd);
+    bool nextRequestReady(int client_fd);
+    bool admitBody(int client_fd, const HttpRequest &request, const Server &server);
+    void rejectRequest(int client_fd, int statusCode, const Server &server, const std::string &response = "");
+    bool rejectBeforeBody(int client_fd, const HttpRequest &request, const Server &server);
+    const Location* matchLocation(const Server &server, const std::string &path);
+    std::vector<std::string> allowedMethods(const Server &server, const Location *location);
+    std::string methodNotAllowedResponse(const std::vector<std::string> &allowedMethods);
+    void processRequest(int client_fd, const HttpRequest &request);
     bool isServerFd(int fd);
     bool isCgiFd(int fd);
     int findMatchingServer(const std::string& host, int port);
+    const Server& defaultServerForPort(int port) const;
+    void updateClientDeadline(int client_fd);
     
     // Response sending
     void sendResponse(int client_fd, const std::string& response);
@@ -0,0 +1,169 @@
+#include "ProcessControl.hpp"
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <sstream>
+#include <stdexcept>
+#include <signal.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <limits.h>
+#include <sys/socket.h>
+#include "../utils/Logger.hpp"
+
+extern char** environ;
+
+int ProcessControl::_quitPipe[2] = { -1, -1 };
+int ProcessControl::_upgradePipe[2] = { -1, -1 };
+std::string ProcessControl::_binaryPath;
+std::vector<std::string> ProcessControl::_argv;
+std::map<std::string, std::vector<int> > ProcessControl::_inherited;
+std::vector<std::pair<std::string, int> > ProcessControl::_listeners;
+
+// Seul travail du handler : réveiller les boucles (write est async-signal-safe)
+void ProcessControl::signalHandler(int signum)
+{
+    int savedErrno = errno;
+    char byte = static_cast<char>(signum);
+    int fd = (signum == SIGQUIT) ? _quitPipe[1] : _upgradePipe[1];
+    if (write(fd, &byte, 1) == -1) {
+        // Pipe plein : le signal est déjà en attente
+    }
+    errno = savedErrno;
+}
+
+std::string ProcessControl::listenerKey(const std::string& host, int port)
+{
+    std::ostringstream oss;
+    oss << host << ":" << port;
+    return oss.str();
+}
+
+// A appeler avant toute création de socket ou de thread
+void ProcessControl::init(int argc, char** argv)
+{
+    // Chemin lu maintenant : après remplacement du binaire, /proc/self/exe désigne l'ancien
+    char path[PATH_MAX];
+    ssize_t len = readlink("/proc/self/exe", path, sizeof(path) - 1);
+    if (len > 0) {
+        path[len] = '\0';
+        _binaryPath = path;
+    } else {
+        _binaryPath = argv[0];
+    }
+    for (int i = 0; i < argc; ++i) {
+        _argv.push_back(argv[i]);
+    }
+
+    // Sockets d'écoute hérités d'un processus précédent (SIGUSR2)
+    const char* inherited = getenv(LISTEN_FDS_ENV);
+    if (inherited) {
+        std::stringstream ss(inherited);
+        std::string entry;
+        while (std::getline(ss, entry, ';')) {
+            size_t eq = entry.rfind('=');
+            if (eq == std::string::npos) {
+                continue;
+            }
+            int fd = atoi(entry.c_str() + eq + 1);
+            int listening = 0;
+            socklen_t optlen = sizeof(listening);
+            // Ne reprendre que de vrais sockets en écoute
+            if (getsockopt(fd, SOL_SOCKET, SO_ACCEPTCONN, &listening, &optlen) == -1 || !listening) {
+                continue;
+            }
+            fcntl(fd, F_SETFD, FD_CLOEXEC);
+            _inherited[entry.substr(0, eq)].push_back(fd);
+        }
+        unsetenv(LISTEN_FDS_ENV);
+    }
+
+    if (pipe(_quitPipe) == -1 || pipe(_upgradePipe) == -1) {
+        throw std::runtime_error("Signal pipe creation failed");
+    }
+    for (int i = 0; i < 2; ++i) {
+        fcntl(_quitPipe[i], F_SETFL, O_NONBLOCK);
+        fcntl(_quitPipe[i], F_SETFD, FD_CLOEXEC);
+        fcntl(_upgradePipe[i], F_SETFL, O_NONBLOCK);
+        fcntl(_upgradePipe[i], F_SETFD, FD_CLOEXEC);
+    }
+
+    struct sigaction sa;
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = &ProcessControl::signalHandler;
+    sigemptyset(&sa.sa_mask);
+    sa.sa_flags = SA_RESTART;
+    sigaction(SIGQUIT, &sa, NULL);
+    sigaction(SIGUSR2, &sa, NULL);
+}
+
+int ProcessControl::takeInheritedListener(const std::string& host, int port)
+{
+    std::map<std::string, std::vector<int> >::iterator it = _inherited.find(listenerKey(host, port));
+    if (it == _inherited.end() || it->second.empty()) {
+        return -1;
+    }
+    int fd = it->second.back();
+    it->second.pop_back();
+    return fd;
+}
+
+// Sockets hérités sans correspondance (port retiré de la configuration, moins de workers)
+void ProcessControl::closeUnusedListeners()
+{
+    for (std::map<std::string, std::vector<int> >::iterator it = _inherited.begin(); it != _inherited.end(); ++it) {
+        for (size_t i = 0; i < it->second.size(); ++i) {
+            Logger::logMsg(YELLOW, CONSOLE_OUTPUT, "Closing unused inherited listener %s (fd %d)",
+                           it->first.c_str(), it->second[i]);
+            close(it->second[i]);
+        }
+    }
+    _inherited.clear();
+}
+
+void ProcessControl::registerListener(const std::string& host, int port, int fd)
+{
+    _listeners.push_back(std::make_pair(listenerKey(host, port), fd));
+}
+
+void ProcessControl::upgrade()
+{
+    char drain[64];
+    while (read(_upgradePipe[0], drain, sizeof(drain)) > 0) {
+    }
+
+    // Tout est préparé avant fork : le fils (processus multithreadé) n'appelle que fcntl et execve
+    std::ostringstream fds;
+    for (size_t i = 0; i < _listeners.size(); ++i) {
+        fds << (i ? ";" : "") << _listeners[i].first << "=" << _listeners[i].second;
+    }
+    std::string envEntry = std::string(LISTEN_FDS_ENV) + "=" + fds.str();
+    std::vector<char*> envp;
+    for (char** env = environ; *env; ++env) {
+        if (strncmp(*env, LISTEN_FDS_ENV "=", sizeof(LISTEN_FDS_ENV)) != 0) {
+            envp.push_back(*env);
+        }
+    }
+    envp.push_back(const_cast<char*>(envEntry.c_str()));
+    envp.push_back(NULL);
+    std::vector<char*> args;
+    for (size_t i = 0; i < _argv.size(); ++i) {
+        args.push_back(const_cast<char*>(_argv[i].c_str()));
+    }
+    args.push_back(NULL);
+
+    pid_t pid = fork();
+    if (pid == -1) {
+        Logger::logMsg(RED, CONSOLE_OUTPUT, "Upgrade failed: fork: %s", strerror(errno));
+        return;
+    }
+    if (pid == 0) {
+        for (size_t i = 0; i < _listeners.size(); ++i) {
+            fcntl(_listeners[i].second, F_SETFD, 0); // Conserver le socket à travers execve
+        }
+        execve(_binaryPath.c_str(), &args[0], &envp[0]);
+        _exit(127);
+    }
+    Logger::logMsg(LIGHTMAGENTA, CONSOLE_OUTPUT, "Upgrade: started %s (PID %d) with %zu listener(s); send SIGQUIT to PID %d to drain this one",
+                   _binaryPath.c_str(), pid, _listeners.size(), getpid());
+}
@@ -0,0 +1,41 @@
+#ifndef PROCESSCONTROL_HPP
+#define PROCESSCONTROL_HPP
+
+#include <string>
+#include <vector>
+#include <map>
+
+#define LISTEN_FDS_ENV "WEBSERV_LISTEN_FDS" // "host:port=fd;host:port=fd;..." transmis au nouveau binaire
+
+// Signaux de pilotage du processus, communs à tous les workers :
+//  - SIGQUIT : arrêt gracieux. Le handler écrit dans un pipe jamais vidé, surveillé par
+//    chaque boucle : elle cesse d'accepter, termine ses réponses et CGI puis sort.
+//  - SIGUSR2 : mise à jour à chaud. Le worker 0 lance le binaire (même chemin, mêmes
+//    arguments) en lui passant les sockets d'écoute ; l'ancien processus continue de
+//    servir jusqu'à ce qu'il reçoive SIGQUIT.
+class ProcessControl {
+private:
+    static int _quitPipe[2];
+    static int _upgradePipe[2];
+    static std::string _binaryPath;
+    static std::vector<std::string> _argv;
+    static std::map<std::string, std::vector<int> > _inherited;  // Sockets reçus de l'ancien processus
+    static std::vector<std::pair<std::string, int> > _listeners; // Sockets à transmettre au prochain
+
+    static void signalHandler(int signum);
+    static std::string listenerKey(const std::string& host, int port);
+
+    ProcessControl();
+
+public:
+    static void init(int argc, char** argv);
+    static int quitFd() { return _quitPipe[0]; }
+    static int upgradeFd() { return _upgradePipe[0]; }
+
+    static int takeInheritedListener(const std::string& host, int port); // -1 : aucun, créer le socket
+    static void closeUnusedListeners();
+    static void registerListener(const std::string& host, int port, int fd);
+    static void upgrade(); // Vide le pipe SIGUSR2 et lance le nouveau binaire
+};
+
+#endif
@@ -1,39 +1,147 @@
 #include "TimeoutManager.hpp"
 #include <ctime> // Added for time_t
 #include <vector>
-#include <sys/time.h>
 #include <cstddef> // Include for NULL
-#include <iostream> // For logging
 
-TimeoutManager::TimeoutManager(int timeoutSeconds) : _timeoutSeconds(timeoutSeconds) {}
+TimeoutManager::TimeoutManager() : _now(0), _lastTick(0), _armed(0) {
+    for (int i = 0; i < TIMER_WHEEL_SLOTS; ++i) {
+        _slots[i] = -1;
+    }
+    updateClock();
+    _lastTick = _now / TIMER_WHEEL_TICK_MS;
+}
+
+// Seule lecture d'horloge : les échéances sont calculées par rapport à cette valeur
+void TimeoutManager::updateClock() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    _now = static_cast<msec_t>(ts.tv_sec) * 1000 + ts.tv_nsec / 1000000;
+}
+
+// (Ré)armer l'échéance d'un fd : ne change de case que si le tick change
+void TimeoutManager::arm(int fd, msec_t deadline) {
+    if (fd < 0) {
+        return;
+    }
+    if (static_cast<size_t>(fd) >= _nodes.size()) {
+        _nodes.resize(fd + 1);
+    }
+    int slot = static_cast<int>((deadline / TIMER_WHEEL_TICK_MS) & (TIMER_WHEEL_SLOTS - 1));
+    TimerNode& node = _nodes[fd];
+    if (node.slot == slot) {
+        node.deadline = deadline;
+        return;
+    }
+    unlink(fd);
+    node.deadline = deadline;
+    node.slot = slot;
+    node.prev = -1;
+    node.next = _slots[slot];
+    if (node.next != -1) {
+        _nodes[node.next].prev = fd;
+    }
+    _slots[slot] = fd;
+    ++_armed;
+}
 
-void TimeoutManager::addClient(int clientFd) {
-    _clientTimeouts[clientFd] = time(NULL); // Use time(NULL) for current timestamp
+void TimeoutManager::unlink(int fd) {
+    if (fd < 0 || static_cast<size_t>(fd) >= _nodes.size() || _nodes[fd].slot == -1) {
+        return;
+    }
+    TimerNode& node = _nodes[fd];
+    if (node.prev != -1) {
+        _nodes[node.prev].next = node.next;
+    } else {
+        _slots[node.slot] = node.next;
+    }
+    if (node.next != -1) {
+        _nodes[node.next].prev = node.prev;
+    }
+    node.slot = -1;
+    node.prev = -1;
+    node.next = -1;
+    --_armed;
 }
 
 void TimeoutManager::removeClient(int clientFd) {
-    _clientTimeouts.erase(clientFd);
+    unlink(clientFd);
 }
 
 bool TimeoutManager::isClientTimedOut(int clientFd) {
-    time_t now = time(NULL);
-    if (_clientTimeouts.find(clientFd) != _clientTimeouts.end()) {
-        return (now - _clientTimeouts[clientFd]) >= _timeoutSeconds;
+    if (clientFd < 0 || static_cast<size_t>(clientFd) >= _nodes.size() || _nodes[clientFd].slot == -1) {
+        return false;
     }
-    return false;
+    return _now >= _nodes[clientFd].deadline;
 }
 
-void TimeoutManager::updateClientActivity(int clientFd) {
-    _clientTimeouts[clientFd] = time(NULL); // Update timestamp to current time
+// Délai relatif : CGI et listeners en attente de fd
+void TimeoutManager::setClientTimeout(int clientFd, int timeoutSeconds) {
+    arm(clientFd, _now + static_cast<msec_t>(timeoutSeconds) * 1000);
 }
 
+// Clients : échéance calculée par phase (EpollClasse::updateClientDeadline)
+void TimeoutManager::setClientDeadline(int clientFd, msec_t deadline) {
+    arm(clientFd, deadline);
+}
+
+// Parcourir les cases écoulées depuis le dernier appel (un tour au plus)
 std::vector<int> TimeoutManager::getTimedOutClients() {
     std::vector<int> timedOutClients;
-    time_t now = time(NULL);
-    for (std::map<int, time_t>::iterator it = _clientTimeouts.begin(); it != _clientTimeouts.end(); ++it) {
-        if ((now - it->second) >= _timeoutSeconds) {
-            timedOutClients.push_back(it->first);
+    msec_t nowTick = _now / TIMER_WHEEL_TICK_MS;
+    msec_t tick = _lastTick;
+    if (nowTick - tick >= TIMER_WHEEL_SLOTS) {
+        tick = nowTick - TIMER_WHEEL_SLOTS + 1;
+    }
+    for (; tick <= nowTick; ++tick) {
+        int fd = _slots[tick & (TIMER_WHEEL_SLOTS - 1)];
+        while (fd != -1) {
+            int next = _nodes[fd].next;
+            if (_nodes[fd].deadline <= _now) {
+                unlink(fd);
+                timedOutClients.push_back(fd);
+            }
+            fd = next;
         }
     }
+    _lastTick = nowTick;
     return timedOutClients;
 }
+
+// Case courante : minimum exact ; cases suivantes : réveil au début de la première case occupée
+int TimeoutManager::wheelTimeoutMs() const {
+    if (_armed == 0) {
+        return -1;
+    }
+    msec_t nowTick = _now / TIMER_WHEEL_TICK_MS;
+    for (int i = 0; i < TIMER_WHEEL_SLOTS; ++i) {
+        msec_t tick = nowTick + i;
+        int fd = _slots[tick & (TIMER_WHEEL_SLOTS - 1)];
+        if (fd == -1) {
+            continue;
+        }
+        if (i > 0) {
+            return static_cast<int>(tick * TIMER_WHEEL_TICK_MS - _now);
+        }
+        msec_t tickEnd = (nowTick + 1) * TIMER_WHEEL_TICK_MS;
+        msec_t earliest = tickEnd;
+        for (; fd != -1; fd = _nodes[fd].next) {
+            if (_nodes[fd].deadline < earliest) {
+                earliest = _nodes[fd].deadline;
+            }
+        }
+        if (earliest < tickEnd) {
+            return (earliest <= _now) ? 0 : static_cast<int>(earliest - _now);
+        }
+    }
+    // Toutes les échéances sont au-delà d'un tour de roue
+    return TIMER_WHEEL_SLOTS * TIMER_WHEEL_TICK_MS;
+}
+
+int TimeoutManager::nextTimeoutMs(msec_t extraDeadline) const {
+    int timeout = wheelTimeoutMs();
+    if (extraDeadline == 0) {
+        return timeout;
+    }
+    int extra = (extraDeadline <= _now) ? 0 : static_cast<int>(extraDeadline - _now);
+    return (timeout == -1 || extra < timeout) ? extra : timeout;
+}
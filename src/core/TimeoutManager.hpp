@@ -1,22 +1,53 @@
 #ifndef TIMEOUTMANAGER_HPP
 #define TIMEOUTMANAGER_HPP
 
-#include <map>
-#include <vector> // Added for returning timed-out clients
-#include <ctime>  // Added for time_t
+#include <vector>
+#include <ctime>
 
+#define TIMER_WHEEL_SLOTS 512   // Nombre de cases de la roue (puissance de 2)
+#define TIMER_WHEEL_TICK_MS 100 // Durée d'une case : un tour complet couvre 51,2 s
+
+// Roue temporelle hachée : chaque fd (client ou pipe CGI) a au plus une échéance,
+// rangée dans la case (échéance / tick) % TIMER_WHEEL_SLOTS. Les échéances plus
+// lointaines qu'un tour restent dans leur case et sont ignorées jusqu'au bon tour.
+// Armer, réarmer et retirer coûtent O(1) ; l'horloge (monotone) n'est lue que par
+// updateClock(), une fois par tour de boucle.
 class TimeoutManager {
+public:
+    typedef long long msec_t;
+
 private:
-    int _timeoutSeconds;
-    std::map<int, time_t> _clientTimeouts; // Changed to use time_t for timestamps
+    struct TimerNode {
+        msec_t deadline;
+        int slot;       // -1 : non armé
+        int prev;
+        int next;
+
+        TimerNode() : deadline(0), slot(-1), prev(-1), next(-1) {}
+    };
+
+    msec_t _now;                    // Horloge monotone en ms, mise en cache
+    msec_t _lastTick;               // Dernière case examinée par getTimedOutClients
+    std::vector<TimerNode> _nodes;  // Indexé par fd
+    int _slots[TIMER_WHEEL_SLOTS];  // Tête de liste de chaque case (-1 : vide)
+    size_t _armed;
+
+    void arm(int fd, msec_t deadline);
+    void unlink(int fd);
+    int wheelTimeoutMs() const;
 
 public:
-    TimeoutManager(int timeoutSeconds);
-    void addClient(int clientFd);
+    TimeoutManager();
+    void updateClock();
     void removeClient(int clientFd);
     bool isClientTimedOut(int clientFd);
-    void updateClientActivity(int clientFd);
-    std::vector<int> getTimedOutClients(); // New method to retrieve timed-out clients
+    void setClientTimeout(int clientFd, int timeoutSeconds); // Échéance spécifique (ex: keep-alive, CGI)
+    void setClientDeadline(int clientFd, msec_t deadline);   // Échéance absolue, sur l'horloge de now()
+    msec_t now() const { return _now; }
+    std::vector<int> getTimedOutClients(); // Désarme et renvoie les fd dont l'échéance est passée
+    // Délai pour epoll_wait jusqu'à la prochaine échéance (-1 : aucune) ; extraDeadline est
+    // une échéance hors de la roue, sur l'horloge de now() (0 : aucune)
+    int nextTimeoutMs(msec_t extraDeadline = 0) const;
 };
 
 #endif // TIMEOUTMANAGER_HPP
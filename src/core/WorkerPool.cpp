@@ -0,0 +1,95 @@
+#include "WorkerPool.hpp"
+#include <cstdlib>
+#include <cstring>
+#include <stdexcept>
+#include <sys/resource.h>
+#include "../utils/Logger.hpp"
+#include "ProcessControl.hpp"
+
+WorkerPool::WorkerPool(const std::vector<ServerConfig>& listeners, const std::vector<Server>& servers, const GlobalConfig& global)
+{
+    int workerCount = global.worker_threads;
+    raiseFileLimit(workerCount, global.connectionsPerWorker());
+    // Les sockets sont créés ici, dans le thread principal : une erreur de bind
+    // remonte à main() avant le démarrage des threads
+    try {
+        for (int i = 0; i < workerCount; ++i) {
+            std::vector<ServerConfig> workerListeners = listeners;
+            for (std::vector<ServerConfig>::iterator it = workerListeners.begin(); it != workerListeners.end(); ++it) {
+                it->setReusePort(workerCount > 1);
+            }
+            EpollClasse* worker = new EpollClasse();
+            _workers.push_back(worker);
+            worker->setEdgeTriggered(global.edge_triggered);
+            worker->setConnectionLimit(global.connectionsPerWorker());
+            worker->setupServers(workerListeners, servers);
+            worker->setFileCache(global.open_file_cache_size, global.open_file_cache_max_file, global.open_file_cache_valid);
+            worker->watchSignals(i == 0);
+        }
+        ProcessControl::closeUnusedListeners();
+    } catch (...) {
+        for (size_t i = 0; i < _workers.size(); ++i) {
+            delete _workers[i];
+        }
+        throw;
+    }
+}
+
+WorkerPool::~WorkerPool()
+{
+    for (size_t i = 0; i < _workers.size(); ++i) {
+        delete _workers[i];
+    }
+}
+
+// Un fd par client, trois par CGI (deux pipes et un pidfd) : relever la limite
+// souple vers ce besoin, sans dépasser la limite dure
+void WorkerPool::raiseFileLimit(int workerCount, int connectionsPerWorker)
+{
+    struct rlimit limit;
+    if (getrlimit(RLIMIT_NOFILE, &limit) == -1) {
+        return;
+    }
+    rlim_t wanted = static_cast<rlim_t>(workerCount) * (connectionsPerWorker + 3 * MAX_CGI_PROCESSES + 16) + 64;
+    if (limit.rlim_cur != RLIM_INFINITY && limit.rlim_cur < wanted) {
+        rlim_t previous = limit.rlim_cur;
+        limit.rlim_cur = (limit.rlim_max == RLIM_INFINITY || wanted < limit.rlim_max) ? wanted : limit.rlim_max;
+        if (limit.rlim_cur > previous && setrlimit(RLIMIT_NOFILE, &limit) == 0) {
+            Logger::logMsg(LIGHTMAGENTA, CONSOLE_OUTPUT, "RLIMIT_NOFILE raised from %lu to %lu",
+                           static_cast<unsigned long>(previous), static_cast<unsigned long>(limit.rlim_cur));
+        }
+    }
+}
+
+void* WorkerPool::workerMain(void* arg)
+{
+    EpollClasse* worker = static_cast<EpollClasse*>(arg);
+    try {
+        worker->serverRun();
+    } catch (const std::exception& e) {
+        // Même comportement qu'en mono-thread : une boucle en erreur arrête le serveur
+        Logger::logMsg(RED, CONSOLE_OUTPUT, "Erreur : %s", e.what());
+        exit(1);
+    }
+    return NULL;
+}
+
+void WorkerPool::run()
+{
+    Logger::logMsg(LIGHTMAGENTA, CONSOLE_OUTPUT, "Starting %zu worker thread(s)", _workers.size());
+    for (size_t i = 1; i < _workers.size(); ++i) {
+        pthread_t thread;
+        int err = pthread_create(&thread, NULL, &WorkerPool::workerMain, _workers[i]);
+        if (err != 0) {
+            Logger::logMsg(RED, CONSOLE_OUTPUT, "pthread_create failed: %s", strerror(err));
+            throw std::runtime_error("Worker thread creation failed");
+        }
+        _threads.push_back(thread);
+    }
+
+    _workers[0]->serverRun();
+
+    for (size_t i = 0; i < _threads.size(); ++i) {
+        pthread_join(_threads[i], NULL);
+    }
+}
@@ -0,0 +1,29 @@
+#ifndef WORKERPOOL_HPP
+#define WORKERPOOL_HPP
+
+#include <vector>
+#include <pthread.h>
+#include "EpollClasse.hpp"
+#include "../config/GlobalConfig.hpp"
+
+// Une boucle EpollClasse par thread, chacune avec ses propres sockets d'écoute
+// (SO_REUSEPORT), timeouts, buffers et CGI : aucun état partagé, aucun verrou.
+class WorkerPool {
+private:
+    std::vector<EpollClasse*> _workers;
+    std::vector<pthread_t> _threads;
+
+    static void* workerMain(void* arg);
+    static void raiseFileLimit(int workerCount, int connectionsPerWorker);
+
+    WorkerPool(const WorkerPool&);
+    WorkerPool& operator=(const WorkerPool&);
+
+public:
+    WorkerPool(const std::vector<ServerConfig>& listeners, const std::vector<Server>& servers, const GlobalConfig& global);
+    ~WorkerPool();
+
+    void run(); // Le worker 0 tourne dans le thread appelant
+};
+
+#endif
@@ -0,0 +1,328 @@
+#include "BufferChain.hpp"
+#include "ByteScan.hpp"
+#include <cstring>
+#include <cerrno>
+#include <unistd.h>
+#include <sys/uio.h>
+
+BufferPool::BufferPool() : _smallSize(0) {}
+
+BufferPool::~BufferPool() {
+    for (size_t i = 0; i < _free.size(); ++i) {
+        delete[] _free[i];
+    }
+    for (size_t i = 0; i < _freeSmall.size(); ++i) {
+        delete[] _freeSmall[i];
+    }
+}
+
+char* BufferPool::acquire() {
+    if (_free.empty()) {
+        return new char[BUFFER_CHUNK_SIZE];
+    }
+    char* chunk = _free.back();
+    _free.pop_back();
+    return chunk;
+}
+
+void BufferPool::release(char* chunk) {
+    if (_free.size() >= BUFFER_POOL_MAX_FREE) {
+        delete[] chunk;
+        return;
+    }
+    _free.push_back(chunk);
+}
+
+void BufferPool::setSmallSize(size_t size) {
+    for (size_t i = 0; i < _freeSmall.size(); ++i) {
+        delete[] _freeSmall[i];
+    }
+    _freeSmall.clear();
+    _smallSize = (size < BUFFER_CHUNK_SIZE) ? size : 0;
+}
+
+char* BufferPool::acquireSmall() {
+    if (_freeSmall.empty()) {
+        return new char[_smallSize];
+    }
+    char* block = _freeSmall.back();
+    _freeSmall.pop_back();
+    return block;
+}
+
+void BufferPool::releaseSmall(char* block) {
+    if (_freeSmall.size() >= BUFFER_POOL_MAX_FREE) {
+        delete[] block;
+        return;
+    }
+    _freeSmall.push_back(block);
+}
+
+BufferChain::BufferChain(BufferPool* pool) : _pool(pool), _head(0), _size(0), _small(false) {}
+
+BufferChain::~BufferChain() {
+    clear();
+}
+
+char BufferChain::at(size_t pos) const {
+    size_t abs = _head + pos;
+    return _chunks[abs / BUFFER_CHUNK_SIZE][abs % BUFFER_CHUNK_SIZE];
+}
+
+// Petit bloc devenu trop petit : son contenu passe dans un bloc entier, aux mêmes offsets
+void BufferChain::promote() {
+    char* chunk = _pool->acquire();
+    memcpy(chunk + _head, _chunks.front() + _head, _size);
+    _pool->releaseSmall(_chunks.front());
+    _chunks.front() = chunk;
+    _small = false;
+}
+
+void BufferChain::releaseBlock(char* block) {
+    if (_small) {
+        _pool->releaseSmall(block); // Toujours le seul bloc de la chaîne
+        _small = false;
+    } else {
+        _pool->release(block);
+    }
+}
+
+// Lecture sans copie intermédiaire : le noyau écrit directement dans les blocs. Une
+// limite qui s'arrête dans le dernier bloc n'offre aucun bloc neuf (pas de trou).
+ssize_t BufferChain::readFrom(int fd, size_t limit) {
+    struct iovec iov[BUFFER_READ_CHUNKS + 1];
+    char* fresh[BUFFER_READ_CHUNKS];
+    int iovcnt = 0;
+    size_t room = (limit == 0) ? static_cast<size_t>(-1) : limit;
+
+    if (_chunks.empty() && limit != 0 && limit <= _pool->smallSize()) {
+        _chunks.push_back(_pool->acquireSmall());
+        _small = true;
+    } else if (_small && (limit == 0 || limit > _pool->smallSize() - (_head + _size))) {
+        promote();
+    }
+    size_t capacity = _small ? _pool->smallSize() : BUFFER_CHUNK_SIZE;
+    size_t tailUsed = _chunks.empty() ? BUFFER_CHUNK_SIZE : (_head + _size) - (_chunks.size() - 1) * BUFFER_CHUNK_SIZE;
+    size_t tailFree = 0;
+    if (tailUsed < capacity) {
+        tailFree = capacity - tailUsed;
+        if (tailFree > room) {
+            tailFree = room;
+        }
+        iov[iovcnt].iov_base = _chunks.back() + tailUsed;
+        iov[iovcnt].iov_len = tailFree;
+        ++iovcnt;
+        room -= tailFree;
+    }
+    int maxFresh = (iovcnt == 0) ? BUFFER_READ_CHUNKS : BUFFER_READ_CHUNKS - 1;
+    int freshCount = 0;
+    while (freshCount < maxFresh && room > 0) {
+        fresh[freshCount] = _pool->acquire();
+        iov[iovcnt].iov_base = fresh[freshCount];
+        iov[iovcnt].iov_len = (room < BUFFER_CHUNK_SIZE) ? room : BUFFER_CHUNK_SIZE;
+        room -= iov[iovcnt].iov_len;
+        ++iovcnt;
+        ++freshCount;
+    }
+
+    ssize_t bytes = readv(fd, iov, iovcnt);
+
+    // Garder les blocs neufs effectivement remplis, rendre les autres au pool
+    size_t remaining = (bytes > 0) ? static_cast<size_t>(bytes) : 0;
+    _size += remaining;
+    remaining -= (remaining < tailFree) ? remaining : tailFree;
+    for (int i = 0; i < freshCount; ++i) {
+        if (remaining > 0) {
+            _chunks.push_back(fresh[i]);
+            remaining -= (remaining < BUFFER_CHUNK_SIZE) ? remaining : BUFFER_CHUNK_SIZE;
+        } else {
+            _pool->release(fresh[i]);
+        }
+    }
+    if (_size == 0 && _small) {
+        clear(); // Rien reçu : le petit bloc retourne au pool
+    }
+    return bytes;
+}
+
+void BufferChain::append(const char* data, size_t len) {
+    if (_small && len > _pool->smallSize() - (_head + _size)) {
+        promote();
+    }
+    while (len > 0) {
+        size_t tailUsed = _chunks.empty() ? BUFFER_CHUNK_SIZE : (_head + _size) - (_chunks.size() - 1) * BUFFER_CHUNK_SIZE;
+        if (tailUsed == BUFFER_CHUNK_SIZE) {
+            _chunks.push_back(_pool->acquire());
+            tailUsed = 0;
+        }
+        size_t n = BUFFER_CHUNK_SIZE - tailUsed;
+        if (n > len) {
+            n = len;
+        }
+        memcpy(_chunks.back() + tailUsed, data, n);
+        data += n;
+        len -= n;
+        _size += n;
+    }
+}
+
+// memchr bloc par bloc sur le premier octet, puis vérification du reste du motif
+size_t BufferChain::find(const char* pattern, size_t len, size_t from) const {
+    size_t pos = from;
+    while (len > 0 && pos + len <= _size) {
+        size_t abs = _head + pos;
+        size_t offset = abs % BUFFER_CHUNK_SIZE;
+        size_t segment = BUFFER_CHUNK_SIZE - offset;
+        if (segment > _size - pos) {
+            segment = _size - pos;
+        }
+        const char* start = _chunks[abs / BUFFER_CHUNK_SIZE] + offset;
+        const char* hit = static_cast<const char*>(memchr(start, pattern[0], segment));
+        if (!hit) {
+            pos += segment;
+            continue;
+        }
+        pos += hit - start;
+        if (pos + len > _size) {
+            break;
+        }
+        size_t k = 1;
+        while (k < len && at(pos + k) == pattern[k]) {
+            ++k;
+        }
+        if (k == len) {
+            return pos;
+        }
+        ++pos;
+    }
+    return std::string::npos;
+}
+
+size_t BufferChain::findAny(char a, char b, size_t from) const {
+    size_t pos = from;
+    while (pos < _size) {
+        size_t abs = _head + pos;
+        size_t offset = abs % BUFFER_CHUNK_SIZE;
+        size_t segment = BUFFER_CHUNK_SIZE - offset;
+        if (segment > _size - pos) {
+            segment = _size - pos;
+        }
+        const char* start = _chunks[abs / BUFFER_CHUNK_SIZE] + offset;
+        const char* hit = ByteScan::findAny(start, start + segment, a, b);
+        if (hit != start + segment) {
+            return pos + (hit - start);
+        }
+        pos += segment;
+    }
+    return std::string::npos;
+}
+
+size_t BufferChain::findByte(char c, size_t from) const {
+    size_t pos = from;
+    while (pos < _size) {
+        size_t abs = _head + pos;
+        size_t offset = abs % BUFFER_CHUNK_SIZE;
+        size_t segment = BUFFER_CHUNK_SIZE - offset;
+        if (segment > _size - pos) {
+            segment = _size - pos;
+        }
+        const char* start = _chunks[abs / BUFFER_CHUNK_SIZE] + offset;
+        const char* hit = static_cast<const char*>(memchr(start, c, segment));
+        if (hit) {
+            return pos + (hit - start);
+        }
+        pos += segment;
+    }
+    return std::string::npos;
+}
+
+size_t BufferChain::contiguous(size_t pos, const char*& data) const {
+    if (pos >= _size) {
+        data = NULL;
+        return 0;
+    }
+    size_t abs = _head + pos;
+    size_t offset = abs % BUFFER_CHUNK_SIZE;
+    size_t n = BUFFER_CHUNK_SIZE - offset;
+    data = _chunks[abs / BUFFER_CHUNK_SIZE] + offset;
+    return (n < _size - pos) ? n : _size - pos;
+}
+
+void BufferChain::copyTo(size_t pos, size_t len, std::string& out) const {
+    if (pos >= _size) {
+        return;
+    }
+    if (len > _size - pos) {
+        len = _size - pos;
+    }
+    out.reserve(out.size() + len);
+    while (len > 0) {
+        size_t abs = _head + pos;
+        size_t offset = abs % BUFFER_CHUNK_SIZE;
+        size_t n = BUFFER_CHUNK_SIZE - offset;
+        if (n > len) {
+            n = len;
+        }
+        out.append(_chunks[abs / BUFFER_CHUNK_SIZE] + offset, n);
+        pos += n;
+        len -= n;
+    }
+}
+
+void BufferChain::consume(size_t len) {
+    if (len >= _size) {
+        clear();
+        return;
+    }
+    _head += len;
+    _size -= len;
+    while (_head >= BUFFER_CHUNK_SIZE) {
+        releaseBlock(_chunks.front());
+        _chunks.pop_front();
+        _head -= BUFFER_CHUNK_SIZE;
+    }
+}
+
+// Pour un fichier régulier : les blocs partent tels quels, sans copie intermédiaire
+bool BufferChain::writeTo(int fd, size_t len) {
+    if (len > _size) {
+        len = _size;
+    }
+    while (len > 0) {
+        struct iovec iov[16];
+        int iovcnt = 0;
+        size_t pos = 0;
+        while (pos < len && iovcnt < 16) {
+            size_t abs = _head + pos;
+            size_t offset = abs % BUFFER_CHUNK_SIZE;
+            size_t n = BUFFER_CHUNK_SIZE - offset;
+            if (n > len - pos) {
+                n = len - pos;
+            }
+            iov[iovcnt].iov_base = _chunks[abs / BUFFER_CHUNK_SIZE] + offset;
+            iov[iovcnt].iov_len = n;
+            ++iovcnt;
+            pos += n;
+        }
+        ssize_t written = writev(fd, iov, iovcnt);
+        if (written <= 0) {
+            if (written == -1 && errno == EINTR) {
+                continue;
+            }
+            return false;
+        }
+        consume(written);
+        len -= written;
+    }
+    return true;
+}
+
+// Rendre tous les blocs : une connexion inactive ne garde aucune mémoire de lecture
+void BufferChain::clear() {
+    for (std::deque<char*>::iterator it = _chunks.begin(); it != _chunks.end(); ++it) {
+        releaseBlock(*it);
+    }
+    _chunks.clear();
+    _head = 0;
+    _size = 0;
+}
@@ -0,0 +1,87 @@
+#ifndef BUFFERCHAIN_HPP
+#define BUFFERCHAIN_HPP
+
+#include <string>
+#include <vector>
+#include <deque>
+#include <sys/types.h>
+
+#define BUFFER_CHUNK_SIZE 16384      // Taille fixe d'un bloc
+#define BUFFER_READ_CHUNKS 4         // Blocs offerts à un readv (64 KB par lecture)
+#define BUFFER_POOL_MAX_FREE 256     // Blocs libres gardés par boucle (4 MB), au-delà rendus au système
+
+// Blocs de taille fixe recyclés par une boucle (pas de verrou : un pool par worker).
+// Les petits blocs (client_header_buffer_size) reçoivent le début d'une tête : une
+// connexion qui attend sa requête ne bloque pas un bloc entier.
+class BufferPool {
+private:
+    std::vector<char*> _free;
+    std::vector<char*> _freeSmall;
+    size_t _smallSize;          // 0 : pas de petits blocs
+
+    BufferPool(const BufferPool&);
+    BufferPool& operator=(const BufferPool&);
+
+public:
+    BufferPool();
+    ~BufferPool();
+
+    char* acquire();
+    void release(char* chunk);
+
+    // A fixer avant la première lecture ; au moins BUFFER_CHUNK_SIZE désactive les petits blocs
+    void setSmallSize(size_t size);
+    size_t smallSize() const { return _smallSize; }
+    char* acquireSmall();
+    void releaseSmall(char* block);
+};
+
+// Chaîne de blocs (rope) : les octets sont lus directement dans les blocs du pool.
+// Invariant : seul le premier bloc a un début non nul (_head) et seul le dernier est
+// partiellement rempli, donc la position logique p est en
+// _chunks[(_head + p) / BUFFER_CHUNK_SIZE] à l'offset (_head + p) % BUFFER_CHUNK_SIZE.
+// Une chaîne vide lue avec une petite limite prend un petit bloc du pool, seul bloc de la
+// chaîne tant qu'il suffit ; dès qu'il faut plus, il est recopié dans un bloc entier aux
+// mêmes positions (promote), et l'invariant reste vrai dans les deux cas.
+class BufferChain {
+private:
+    BufferPool* _pool;
+    std::deque<char*> _chunks;
+    size_t _head;   // Octets déjà consommés dans le premier bloc
+    size_t _size;   // Octets disponibles
+    bool _small;    // Le seul bloc est un petit bloc du pool
+
+    void promote();
+    void releaseBlock(char* block);
+
+    BufferChain(const BufferChain&);
+    BufferChain& operator=(const BufferChain&);
+
+public:
+    explicit BufferChain(BufferPool* pool);
+    ~BufferChain();
+
+    size_t size() const { return _size; }
+    bool empty() const { return _size == 0; }
+    bool isSmall() const { return _small; }
+    char at(size_t pos) const;
+
+    // Un readv dans la place libre du dernier bloc + blocs neufs, au plus limit octets (0 : sans
+    // limite). Chaîne vide et limite d'au plus un petit bloc : lecture dans un petit bloc.
+    ssize_t readFrom(int fd, size_t limit = 0);
+    void append(const char* data, size_t len);
+
+    // Recherche d'un motif à partir de from, même à cheval sur deux blocs (npos si absent)
+    size_t find(const char* pattern, size_t len, size_t from = 0) const;
+    // Premier octet égal à a ou b à partir de from (ByteScan, bloc par bloc ; npos si absent)
+    size_t findAny(char a, char b, size_t from = 0) const;
+    // Premier octet égal à c à partir de from (memchr, bloc par bloc ; npos si absent)
+    size_t findByte(char c, size_t from = 0) const;
+    void copyTo(size_t pos, size_t len, std::string& out) const; // Ajoute à out, sans réallocation
+    size_t contiguous(size_t pos, const char*& data) const; // Octets lisibles d'un bloc à partir de pos
+    void consume(size_t len);   // Retire len octets en tête, rend les blocs vidés au pool
+    bool writeTo(int fd, size_t len); // Ecrit (writev bloquant) puis consomme len octets de tête
+    void clear();
+};
+
+#endif
@@ -0,0 +1,116 @@
+#include "ByteRange.hpp"
+#include <algorithm>
+#include <limits>
+#include <strings.h>
+
+static bool isOws(char c) {
+    return c == ' ' || c == '\t';
+}
+
+// Entier décimal saturé : une borne au-delà de off_t reste simplement hors du fichier
+static bool parseOffset(const std::string& s, size_t& pos, off_t& value) {
+    size_t start = pos;
+    const off_t max = std::numeric_limits<off_t>::max();
+    value = 0;
+    while (pos < s.size() && s[pos] >= '0' && s[pos] <= '9') {
+        off_t digit = s[pos] - '0';
+        value = (value > (max - digit) / 10) ? max : value * 10 + digit;
+        ++pos;
+    }
+    return pos > start;
+}
+
+static bool byFirst(const ByteRange& a, const ByteRange& b) {
+    return a.first < b.first;
+}
+
+ByteRanges::Result ByteRanges::parse(const std::string& header, off_t size, std::vector<ByteRange>& out) {
+    out.clear();
+    size_t pos = 0;
+    while (pos < header.size() && isOws(header[pos])) {
+        ++pos;
+    }
+    if (header.size() - pos < 6 || strncasecmp(header.c_str() + pos, "bytes=", 6) != 0) {
+        return RANGE_NONE;
+    }
+    pos += 6;
+
+    size_t specs = 0;
+    bool any = false;
+    while (true) {
+        while (pos < header.size() && isOws(header[pos])) {
+            ++pos;
+        }
+        if (pos < header.size() && header[pos] == ',') {
+            ++pos; // Élément vide de la liste : toléré
+            continue;
+        }
+        if (pos >= header.size()) {
+            break;
+        }
+        if (++specs > RANGE_MAX_SPECS) {
+            out.clear();
+            return RANGE_NONE;
+        }
+
+        // Intervalle vide une fois ramené au fichier (last < first) : insatisfiable
+        ByteRange range;
+        if (header[pos] == '-') {
+            // "-N" : les N derniers octets
+            ++pos;
+            off_t suffix;
+            if (!parseOffset(header, pos, suffix)) {
+                out.clear();
+                return RANGE_NONE;
+            }
+            range.first = (suffix >= size) ? 0 : size - suffix;
+            range.last = size - 1;
+        } else {
+            off_t last;
+            if (!parseOffset(header, pos, range.first) || pos >= header.size() || header[pos] != '-') {
+                out.clear();
+                return RANGE_NONE;
+            }
+            ++pos;
+            bool hasLast = parseOffset(header, pos, last);
+            if (hasLast && last < range.first) {
+                out.clear();
+                return RANGE_NONE;
+            }
+            range.last = (!hasLast || last >= size) ? size - 1 : last;
+        }
+        any = true;
+        if (range.last >= range.first) {
+            out.push_back(range);
+        }
+
+        while (pos < header.size() && isOws(header[pos])) {
+            ++pos;
+        }
+        if (pos < header.size() && header[pos] != ',') {
+            out.clear();
+            return RANGE_NONE;
+        }
+    }
+    if (!any) {
+        return RANGE_NONE;
+    }
+    if (out.empty()) {
+        return RANGE_UNSATISFIABLE;
+    }
+
+    // Fusion : une réponse multipart n'envoie jamais deux fois le même octet
+    std::sort(out.begin(), out.end(), byFirst);
+    size_t kept = 0;
+    for (size_t i = 1; i < out.size(); ++i) {
+        if (out[i].first <= out[kept].last + 1) {
+            if (out[i].last > out[kept].last) {
+                out[kept].last = out[i].last;
+            }
+        } else {
+            out[++kept] = out[i];
+        }
+    }
+    out.resize(kept + 1);
+    return RANGE_OK;
+}
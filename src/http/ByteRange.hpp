@@ -0,0 +1,32 @@
+#ifndef BYTERANGE_HPP
+#define BYTERANGE_HPP
+
+#include <string>
+#include <vector>
+#include <sys/types.h>
+
+#define RANGE_MAX_SPECS 64  // Au-delà, l'en-tête Range est ignoré (réponse 200 complète)
+
+// Intervalle d'octets d'une représentation, bornes incluses
+struct ByteRange {
+    off_t first;
+    off_t last;
+
+    off_t length() const { return last - first + 1; }
+};
+
+// En-tête Range ("bytes=0-499,-500,9500-") rapporté à une taille connue : intervalles
+// ramenés dans le fichier, triés, ceux qui se chevauchent ou se touchent fusionnés.
+// Une syntaxe invalide ou une autre unité que bytes fait ignorer l'en-tête.
+class ByteRanges {
+public:
+    enum Result {
+        RANGE_NONE,             // En-tête ignoré : servir la représentation complète
+        RANGE_OK,
+        RANGE_UNSATISFIABLE     // Aucun intervalle dans le fichier : 416
+    };
+
+    static Result parse(const std::string& header, off_t size, std::vector<ByteRange>& out);
+};
+
+#endif
@@ -0,0 +1,163 @@
+#include "ByteScan.hpp"
+#include <cstring>
+#include <ctime>
+
+#if defined(__GNUC__) && defined(__SSE2__)
+# define BYTESCAN_X86 1
+# include <emmintrin.h>
+# include <immintrin.h>
+#endif
+
+const char* ByteScan::_name = "scalar";
+ByteScan::FindFn ByteScan::_find = ByteScan::detect();
+
+const char* ByteScan::findScalar(const char* begin, const char* end, char a, char b, char c) {
+    for (const char* p = begin; p < end; ++p) {
+        if (*p == a || *p == b || *p == c) {
+            return p;
+        }
+    }
+    return end;
+}
+
+#ifdef BYTESCAN_X86
+
+// 16 octets par itération : trois comparaisons, un OR, le premier bit du masque
+static const char* findSse2(const char* begin, const char* end, char a, char b, char c) {
+    const __m128i va = _mm_set1_epi8(a);
+    const __m128i vb = _mm_set1_epi8(b);
+    const __m128i vc = _mm_set1_epi8(c);
+    const char* p = begin;
+    for (; end - p >= 16; p += 16) {
+        __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+        __m128i hits = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(chunk, va), _mm_cmpeq_epi8(chunk, vb)),
+                                    _mm_cmpeq_epi8(chunk, vc));
+        int mask = _mm_movemask_epi8(hits);
+        if (mask) {
+            return p + __builtin_ctz(mask);
+        }
+    }
+    return ByteScan::findScalar(p, end, a, b, c);
+}
+
+// 32 octets par itération ; compilée pour AVX2 seule, appelée seulement si le CPU le permet
+__attribute__((target("avx2")))
+static const char* findAvx2(const char* begin, const char* end, char a, char b, char c) {
+    const __m256i va = _mm256_set1_epi8(a);
+    const __m256i vb = _mm256_set1_epi8(b);
+    const __m256i vc = _mm256_set1_epi8(c);
+    const char* p = begin;
+    for (; end - p >= 32; p += 32) {
+        __m256i chunk = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p));
+        __m256i hits = _mm256_or_si256(_mm256_or_si256(_mm256_cmpeq_epi8(chunk, va), _mm256_cmpeq_epi8(chunk, vb)),
+                                       _mm256_cmpeq_epi8(chunk, vc));
+        unsigned int mask = static_cast<unsigned int>(_mm256_movemask_epi8(hits));
+        if (mask) {
+            return p + __builtin_ctz(mask);
+        }
+    }
+    // Le saut final vers findSse2 (code SSE non VEX) est un appel terminal : GCC n'y place
+    // pas de vzeroupper, et chaque instruction SSE paierait alors la moitié haute sale
+    _mm256_zeroupper();
+    return findSse2(p, end, a, b, c);
+}
+
+#endif
+
+bool ByteScan::select(const char* name) {
+    if (strcmp(name, "scalar") == 0) {
+        _find = &ByteScan::findScalar;
+        _name = "scalar";
+        return true;
+    }
+#ifdef BYTESCAN_X86
+    __builtin_cpu_init();
+    if (strcmp(name, "sse2") == 0 && __builtin_cpu_supports("sse2")) {
+        _find = &findSse2;
+        _name = "sse2";
+        return true;
+    }
+    if (strcmp(name, "avx2") == 0 && __builtin_cpu_supports("avx2")) {
+        _find = &findAvx2;
+        _name = "avx2";
+        return true;
+    }
+#endif
+    return false;
+}
+
+// Initialisation statique, avant main et donc avant le démarrage des workers : le choix
+// ne dépend que de cpuid (AVX2, sinon SSE2, sinon boucle scalaire)
+ByteScan::FindFn ByteScan::detect() {
+    if (select("avx2") || select("sse2")) {
+        return _find;
+    }
+    select("scalar");
+    return _find;
+}
+
+// Tête type : lignes courtes, délimiteurs à quelques dizaines d'octets les uns des autres
+static const char CALIBRATION_SAMPLE[] =
+    "GET /index.html?lang=fr HTTP/1.1\r\n"
+    "Host: www.example.com\r\n"
+    "User-Agent: Mozilla/5.0 (X11; Linux x86_64; rv:109.0) Gecko/20100101 Firefox/115.0\r\n"
+    "Accept: text/html,application/xhtml+xml,application/xml;q=0.9,*/*;q=0.8\r\n"
+    "Accept-Language: fr-FR,fr;q=0.8,en-US;q=0.5,en;q=0.3\r\n"
+    "Accept-Encoding: gzip, deflate, br\r\n"
+    "Referer: https://www.example.com/catalogue/produits/page-2\r\n"
+    "Cookie: session=4f9c2a7e1b3d8c6f; theme=dark; consent=1\r\n"
+    "Connection: keep-alive\r\n"
+    "Cache-Control: max-age=0\r\n"
+    "\r\n";
+
+static long elapsedNs(const struct timespec& start, const struct timespec& end) {
+    return (end.tv_sec - start.tv_sec) * 1000000000L + (end.tv_nsec - start.tv_nsec);
+}
+
+// Meilleur de plusieurs tours : chaque tour parcourt l'échantillon délimiteur par délimiteur
+static long timeKernel() {
+    const char* end = CALIBRATION_SAMPLE + sizeof(CALIBRATION_SAMPLE) - 1;
+    long best = -1;
+    volatile size_t sink = 0;
+    for (int round = 0; round < 5; ++round) {
+        struct timespec start, stop;
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        for (int rep = 0; rep < 200; ++rep) {
+            const char* p = CALIBRATION_SAMPLE;
+            while ((p = ByteScan::findAny(p, end, '\r', ':')) != end) {
+                ++p;
+            }
+            sink = sink + (p - CALIBRATION_SAMPLE);
+        }
+        clock_gettime(CLOCK_MONOTONIC, &stop);
+        long ns = elapsedNs(start, stop);
+        if (best < 0 || ns < best) {
+            best = ns;
+        }
+    }
+    return best;
+}
+
+// Les noyaux larges ne sont gardés que s'ils battent nettement le plus étroit : à égalité,
+// SSE2 évite les transitions AVX et la baisse de fréquence de certains CPU
+const char* ByteScan::calibrate() {
+    static const char* const candidates[] = { "scalar", "sse2", "avx2" };
+    FindFn bestFn = _find;
+    const char* bestName = _name;
+    long bestNs = -1;
+    for (size_t i = 0; i < sizeof(candidates) / sizeof(candidates[0]); ++i) {
+        if (!select(candidates[i])) {
+            continue;
+        }
+        timeKernel(); // Echauffement : caches et pages de code
+        long ns = timeKernel();
+        if (bestNs < 0 || ns < bestNs - bestNs / 10) {
+            bestFn = _find;
+            bestName = _name;
+            bestNs = ns;
+        }
+    }
+    _find = bestFn;
+    _name = bestName;
+    return _name;
+}
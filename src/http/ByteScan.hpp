@@ -0,0 +1,37 @@
+#ifndef BYTESCAN_HPP
+#define BYTESCAN_HPP
+
+#include <cstddef>
+
+// Recherche du premier octet parmi deux ou trois (\r et ':' pour les en-têtes, '%' et '/'
+// pour les chemins), 16 ou 32 octets à la fois. A l'initialisation statique, cpuid donne
+// un choix sûr (AVX2, SSE2, sinon boucle scalaire) ; calibrate() le remplace ensuite par
+// le plus rapide mesuré sur une tête type.
+class ByteScan {
+public:
+    typedef const char* (*FindFn)(const char*, const char*, char, char, char);
+
+    // Premier octet de [begin, end) égal à a, b ou c ; end si absent
+    static const char* findAny(const char* begin, const char* end, char a, char b, char c) {
+        return _find(begin, end, a, b, c);
+    }
+    static const char* findAny(const char* begin, const char* end, char a, char b) {
+        return _find(begin, end, a, b, b);
+    }
+
+    static const char* implementation() { return _name; }
+    static bool select(const char* name); // "scalar", "sse2" ou "avx2" ; false si non supporté
+    // Chronomètre chaque noyau supporté et garde le plus rapide ; à appeler une fois, avant
+    // le démarrage des threads (le pointeur choisi n'est pas protégé)
+    static const char* calibrate();
+
+    static const char* findScalar(const char* begin, const char* end, char a, char b, char c);
+
+private:
+    static FindFn _find;
+    static const char* _name;
+
+    static FindFn detect();
+};
+
+#endif
@@ -86,7 +86,8 @@ bool Cookie::isValid() const {
 }
 
 std::string Cookie::formatTime(time_t time) {
-    struct tm* gmt = gmtime(&time);
+    struct tm gmtBuf;
+    struct tm* gmt = gmtime_r(&time, &gmtBuf); // gmtime() partage un buffer statique entre threads
     std::ostringstream oss;
     
     // Format: Wdy, DD Mon YYYY HH:MM:SS GMT
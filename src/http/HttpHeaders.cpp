@@ -0,0 +1,114 @@
+#include "HttpHeaders.hpp"
+#include <strings.h>   // strncasecmp
+
+// Dans l'ordre de HttpHeaderId
+const HttpHeaderDef HTTP_HEADERS[HDR_COUNT] = {
+    { "Accept",                    "HTTP_ACCEPT" },
+    { "Accept-Charset",            "HTTP_ACCEPT_CHARSET" },
+    { "Accept-Encoding",           "HTTP_ACCEPT_ENCODING" },
+    { "Accept-Language",           "HTTP_ACCEPT_LANGUAGE" },
+    { "Authorization",             "HTTP_AUTHORIZATION" },
+    { "Cache-Control",             "HTTP_CACHE_CONTROL" },
+    { "Connection",                "HTTP_CONNECTION" },
+    { "Content-Length",            "HTTP_CONTENT_LENGTH" },
+    { "Content-Type",              "HTTP_CONTENT_TYPE" },
+    { "Cookie",                    "HTTP_COOKIE" },
+    { "Expect",                    "HTTP_EXPECT" },
+    { "Host",                      "HTTP_HOST" },
+    { "If-Match",                  "HTTP_IF_MATCH" },
+    { "If-Modified-Since",         "HTTP_IF_MODIFIED_SINCE" },
+    { "If-None-Match",             "HTTP_IF_NONE_MATCH" },
+    { "If-Range",                  "HTTP_IF_RANGE" },
+    { "If-Unmodified-Since",       "HTTP_IF_UNMODIFIED_SINCE" },
+    { "Keep-Alive",                "HTTP_KEEP_ALIVE" },
+    { "Origin",                    "HTTP_ORIGIN" },
+    { "Pragma",                    "HTTP_PRAGMA" },
+    { "Range",                     "HTTP_RANGE" },
+    { "Referer",                   "HTTP_REFERER" },
+    { "TE",                        "HTTP_TE" },
+    { "Transfer-Encoding",         "HTTP_TRANSFER_ENCODING" },
+    { "Upgrade",                   "HTTP_UPGRADE" },
+    { "Upgrade-Insecure-Requests", "HTTP_UPGRADE_INSECURE_REQUESTS" },
+    { "User-Agent",                "HTTP_USER_AGENT" },
+    { "X-Forwarded-For",           "HTTP_X_FORWARDED_FOR" }
+};
+
+static char lower(char c) {
+    return (c >= 'A' && c <= 'Z') ? static_cast<char>(c + ('a' - 'A')) : c;
+}
+
+static HttpHeaderId match(const char* name, size_t len, HttpHeaderId id) {
+    return (strncasecmp(name, HTTP_HEADERS[id].name, len) == 0) ? id : HDR_UNKNOWN;
+}
+
+HttpHeaderId httpHeaderLookup(const char* name, size_t len) {
+    if (len == 0) {
+        return HDR_UNKNOWN;
+    }
+    char first = lower(name[0]);
+    switch (len) {
+    case 2:
+        if (first == 't') return match(name, len, HDR_TE);
+        break;
+    case 4:
+        if (first == 'h') return match(name, len, HDR_HOST);
+        break;
+    case 5:
+        if (first == 'r') return match(name, len, HDR_RANGE);
+        break;
+    case 6:
+        switch (first) {
+        case 'a': return match(name, len, HDR_ACCEPT);
+        case 'c': return match(name, len, HDR_COOKIE);
+        case 'e': return match(name, len, HDR_EXPECT);
+        case 'o': return match(name, len, HDR_ORIGIN);
+        case 'p': return match(name, len, HDR_PRAGMA);
+        }
+        break;
+    case 7:
+        if (first == 'r') return match(name, len, HDR_REFERER);
+        if (first == 'u') return match(name, len, HDR_UPGRADE);
+        break;
+    case 8:
+        // If-Match / If-Range : départagés par le 4e octet
+        if (first == 'i') return match(name, len, (lower(name[3]) == 'm') ? HDR_IF_MATCH : HDR_IF_RANGE);
+        break;
+    case 10:
+        switch (first) {
+        case 'c': return match(name, len, HDR_CONNECTION);
+        case 'k': return match(name, len, HDR_KEEP_ALIVE);
+        case 'u': return match(name, len, HDR_USER_AGENT);
+        }
+        break;
+    case 12:
+        if (first == 'c') return match(name, len, HDR_CONTENT_TYPE);
+        break;
+    case 13:
+        switch (first) {
+        case 'a': return match(name, len, HDR_AUTHORIZATION);
+        case 'c': return match(name, len, HDR_CACHE_CONTROL);
+        case 'i': return match(name, len, HDR_IF_NONE_MATCH);
+        }
+        break;
+    case 14:
+        if (first == 'a') return match(name, len, HDR_ACCEPT_CHARSET);
+        if (first == 'c') return match(name, len, HDR_CONTENT_LENGTH);
+        break;
+    case 15:
+        // Accept-Encoding / Accept-Language : départagés par le 8e octet
+        if (first == 'a') return match(name, len, (lower(name[7]) == 'e') ? HDR_ACCEPT_ENCODING : HDR_ACCEPT_LANGUAGE);
+        if (first == 'x') return match(name, len, HDR_X_FORWARDED_FOR);
+        break;
+    case 17:
+        if (first == 'i') return match(name, len, HDR_IF_MODIFIED_SINCE);
+        if (first == 't') return match(name, len, HDR_TRANSFER_ENCODING);
+        break;
+    case 19:
+        if (first == 'i') return match(name, len, HDR_IF_UNMODIFIED_SINCE);
+        break;
+    case 25:
+        if (first == 'u') return match(name, len, HDR_UPGRADE_INSECURE_REQUESTS);
+        break;
+    }
+    return HDR_UNKNOWN;
+}
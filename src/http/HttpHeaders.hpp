@@ -0,0 +1,51 @@
+#ifndef HTTPHEADERS_HPP
+#define HTTPHEADERS_HPP
+
+#include <cstddef>
+
+// En-têtes de requête connus : reconnus une fois à la réception, puis retrouvés par
+// indexation (HttpRequest::findHeader(HttpHeaderId)) au lieu de comparer des chaînes
+enum HttpHeaderId {
+    HDR_ACCEPT,
+    HDR_ACCEPT_CHARSET,
+    HDR_ACCEPT_ENCODING,
+    HDR_ACCEPT_LANGUAGE,
+    HDR_AUTHORIZATION,
+    HDR_CACHE_CONTROL,
+    HDR_CONNECTION,
+    HDR_CONTENT_LENGTH,
+    HDR_CONTENT_TYPE,
+    HDR_COOKIE,
+    HDR_EXPECT,
+    HDR_HOST,
+    HDR_IF_MATCH,
+    HDR_IF_MODIFIED_SINCE,
+    HDR_IF_NONE_MATCH,
+    HDR_IF_RANGE,
+    HDR_IF_UNMODIFIED_SINCE,
+    HDR_KEEP_ALIVE,
+    HDR_ORIGIN,
+    HDR_PRAGMA,
+    HDR_RANGE,
+    HDR_REFERER,
+    HDR_TE,
+    HDR_TRANSFER_ENCODING,
+    HDR_UPGRADE,
+    HDR_UPGRADE_INSECURE_REQUESTS,
+    HDR_USER_AGENT,
+    HDR_X_FORWARDED_FOR,
+    HDR_COUNT,
+    HDR_UNKNOWN = HDR_COUNT
+};
+
+struct HttpHeaderDef {
+    const char* name;       // Forme canonique ("Content-Type")
+    const char* cgiName;    // Variable CGI ("HTTP_CONTENT_TYPE"), précalculée
+};
+
+extern const HttpHeaderDef HTTP_HEADERS[HDR_COUNT];
+
+// Aiguillage sur la longueur puis le premier octet, une seule comparaison (sans casse)
+HttpHeaderId httpHeaderLookup(const char* name, size_t len);
+
+#endif
@@ -0,0 +1,635 @@
+#include "HttpRequest.hpp"
+#include "MultipartUpload.hpp"
+#include <cstdlib>
+#include <cstring>
+#include <strings.h>   // strncasecmp
+#include <cctype>
+#include <cerrno>
+#include <fcntl.h>
+#include <unistd.h>
+
+#define MAX_CHUNK_LINE 1024      // Taille + extensions
+#define MAX_TRAILER_LINE 8192
+
+HttpRequest::HttpRequest() : bodyFd(-1), bodyFileSize(0), upload(NULL), isChunked(false), contentLength(0) {
+    for (int i = 0; i < HDR_COUNT; ++i) {
+        known[i] = -1;
+    }
+}
+
+HttpRequest::~HttpRequest() {
+    clear();
+}
+
+// Nom connu : indexation directe ; sinon parcours des seuls en-têtes inconnus
+const HttpHeaderField* HttpRequest::findHeader(const char* name) const {
+    size_t len = strlen(name);
+    HttpHeaderId id = httpHeaderLookup(name, len);
+    if (id != HDR_UNKNOWN) {
+        return findHeader(id);
+    }
+    for (size_t i = 0; i < fields.size(); ++i) {
+        if (fields[i].id == HDR_UNKNOWN && fields[i].name.len == len
+            && strncasecmp(head.c_str() + fields[i].name.off, name, len) == 0) {
+            return &fields[i];
+        }
+    }
+    return NULL;
+}
+
+std::string HttpRequest::getHeader(HttpHeaderId id) const {
+    const HttpHeaderField* field = findHeader(id);
+    return field ? str(field->value) : std::string();
+}
+
+std::string HttpRequest::getHeader(const char* name) const {
+    const HttpHeaderField* field = findHeader(name);
+    return field ? str(field->value) : std::string();
+}
+
+// Une fois par requête, quand head est contigu : chaque nom est reconnu une seule fois
+void HttpRequest::indexHeaders() {
+    for (int i = 0; i < HDR_COUNT; ++i) {
+        known[i] = -1;
+    }
+    for (size_t i = 0; i < fields.size(); ++i) {
+        HttpHeaderField& field = fields[i];
+        field.id = httpHeaderLookup(head.data() + field.name.off, field.name.len);
+        if (field.id != HDR_UNKNOWN && known[field.id] < 0) {
+            known[field.id] = static_cast<int>(i);
+        }
+    }
+}
+
+void HttpRequest::clear() {
+    head.clear();
+    body.clear();
+    if (bodyFd != -1) {
+        close(bodyFd);
+        bodyFd = -1;
+    }
+    bodyFileSize = 0;
+    delete upload;
+    upload = NULL;
+    method = target = version = HttpSpan();
+    fields.clear();
+    for (int i = 0; i < HDR_COUNT; ++i) {
+        known[i] = -1;
+    }
+    isChunked = false;
+    contentLength = 0;
+}
+
+// Limites par défaut de nginx : 1 KB, puis 4 tampons de 8 KB
+HttpRequestParser::HttpRequestParser()
+    : _headerBufferSize(1024), _largeHeaderBuffers(4), _largeHeaderBufferSize(8192) {
+    reset();
+}
+
+void HttpRequestParser::setHeaderLimits(size_t bufferSize, size_t largeBuffers, size_t largeBufferSize) {
+    _headerBufferSize = bufferSize;
+    _largeHeaderBuffers = largeBuffers;
+    _largeHeaderBufferSize = largeBufferSize;
+}
+
+// Une requête ordinaire tient dans la petite fenêtre (un petit bloc du pool) ; au-delà,
+// lectures de la taille d'un grand tampon jusqu'à la limite de la tête. Le corps est lu
+// sans limite.
+size_t HttpRequestParser::readWindow(const BufferChain& buffer) const {
+    if (_state != REQUEST_LINE && _state != HEADERS) {
+        return 0;
+    }
+    size_t head = buffer.size() - _start;
+    return (head < _headerBufferSize) ? _headerBufferSize - head : _largeHeaderBufferSize;
+}
+
+// Tête reçue jusqu'à end : une ligne trop longue reçoit 414 (ligne de requête) ou 431,
+// une tête trop grande 431
+bool HttpRequestParser::checkHeadSize(size_t end) {
+    if (end - _pos > _largeHeaderBufferSize) {
+        return fail((_state == REQUEST_LINE) ? 414 : 431);
+    }
+    if (end - _start > _largeHeaderBuffers * _largeHeaderBufferSize) {
+        return fail(431);
+    }
+    return true;
+}
+
+void HttpRequestParser::reset() {
+    _state = REQUEST_LINE;
+    _start = 0;
+    _pos = 0;
+    _scan = 0;
+    _colon = std::string::npos;
+    _remaining = 0;
+    _bodyLimit = 0;
+    _bodyBufferSize = 0;
+    _bodyReceived = 0;
+    _errorStatus = 0;
+    _request.clear();
+}
+
+static bool isBlank(char c) {
+    return c == ' ' || c == '\t';
+}
+
+// Ligne [pos, lineEnd) d'un seul tenant : lue directement dans son bloc, ou copiée dans
+// _line dans le cas rare où elle est à cheval sur deux blocs
+const char* HttpRequestParser::lineData(const BufferChain& buffer, size_t pos, size_t lineEnd) {
+    const char* data;
+    if (buffer.contiguous(pos, data) >= lineEnd - pos) {
+        return data;
+    }
+    _line.clear();
+    buffer.copyTo(pos, lineEnd - pos, _line);
+    return _line.data();
+}
+
+// "METHOD SP target SP version" ; les champs manquants restent vides (400 au traitement),
+// un mot de plus après la version est refusé (400)
+bool HttpRequestParser::parseRequestLine(const BufferChain& buffer, size_t lineEnd) {
+    if (lineEnd == _pos) {
+        // CRLF entre deux requêtes (toléré par la RFC 7230)
+        _pos += 2;
+        _start = _pos;
+        return false;
+    }
+    const char* line = lineData(buffer, _pos, lineEnd);
+    size_t len = lineEnd - _pos;
+    size_t base = _pos - _start;
+    HttpSpan* parts[3] = { &_request.method, &_request.target, &_request.version };
+    size_t p = 0;
+    for (int i = 0; i < 3; ++i) {
+        while (p < len && isBlank(line[p])) {
+            ++p;
+        }
+        size_t begin = p;
+        while (p < len && !isBlank(line[p])) {
+            ++p;
+        }
+        *parts[i] = HttpSpan(base + begin, p - begin);
+    }
+    while (p < len && isBlank(line[p])) {
+        ++p;
+    }
+    if (p < len) {
+        return fail(400);
+    }
+    return true;
+}
+
+// "Nom: valeur" ; le ':' a été relevé pendant la recherche de fin de ligne. Tout ce qu'un
+// intermédiaire pourrait lire autrement est refusé (400) : ligne sans ':', nom vide,
+// blanc entre le nom et ':' (RFC 9112 5.1), ligne commençant par un blanc (obs-fold)
+bool HttpRequestParser::parseHeaderLine(const BufferChain& buffer, size_t lineEnd) {
+    if (_colon == std::string::npos) {
+        return fail(400);
+    }
+    const char* line = lineData(buffer, _pos, lineEnd);
+    size_t nameEnd = _colon - _pos;
+    if (nameEnd == 0 || isBlank(line[0]) || isBlank(line[nameEnd - 1])) {
+        return fail(400);
+    }
+    size_t valueBegin = nameEnd + 1;
+    size_t valueEnd = lineEnd - _pos;
+    while (valueBegin < valueEnd && isBlank(line[valueBegin])) {
+        ++valueBegin;
+    }
+    while (valueEnd > valueBegin && isBlank(line[valueEnd - 1])) {
+        --valueEnd;
+    }
+    size_t base = _pos - _start;
+    HttpHeaderField field;
+    field.name = HttpSpan(base, nameEnd);
+    field.value = HttpSpan(base + valueBegin, valueEnd - valueBegin);
+    field.id = HDR_UNKNOWN; // Reconnu dans finishHead, une fois la tête contiguë
+    _request.fields.push_back(field);
+    return true;
+}
+
+// Content-Length : uniquement des chiffres, sans dépassement
+static bool parseContentLength(const char* data, size_t len, size_t& out) {
+    if (len == 0) {
+        return false;
+    }
+    size_t value = 0;
+    for (size_t i = 0; i < len; ++i) {
+        if (data[i] < '0' || data[i] > '9') {
+            return false;
+        }
+        size_t digit = data[i] - '0';
+        if (value > (static_cast<size_t>(-1) - digit) / 10) {
+            return false;
+        }
+        value = value * 10 + digit;
+    }
+    out = value;
+    return true;
+}
+
+// "1*HEXDIG [ BWS ; extensions ]" : ni blanc de tête, ni signe, ni préfixe 0x (strtoul
+// les accepterait, un intermédiaire les lirait autrement). Dépassement refusé avant
+// chaque décalage.
+static bool parseChunkSize(const char* data, size_t len, size_t& out) {
+    size_t value = 0;
+    size_t i = 0;
+    for (; i < len; ++i) {
+        char c = data[i];
+        int digit;
+        if (c >= '0' && c <= '9') {
+            digit = c - '0';
+        } else if (c >= 'a' && c <= 'f') {
+            digit = c - 'a' + 10;
+        } else if (c >= 'A' && c <= 'F') {
+            digit = c - 'A' + 10;
+        } else {
+            break;
+        }
+        if (value > (static_cast<size_t>(-1) >> 4)) {
+            return false;
+        }
+        value = (value << 4) | static_cast<size_t>(digit);
+    }
+    if (i == 0) {
+        return false;
+    }
+    if (i < len) {
+        while (i < len && (data[i] == ' ' || data[i] == '\t')) {
+            ++i;
+        }
+        if (i == len || data[i] != ';') {
+            return false;
+        }
+    }
+    out = value;
+    return true;
+}
+
+// Cadrage du corps (RFC 9112 6.1-6.3). Toute ambiguïté est refusée plutôt que devinée :
+// un intermédiaire qui lirait la requête autrement désynchroniserait la connexion.
+// Transfer-Encoding : aucun autre codage que chunked n'est supporté (501), et chunked
+// doit être le dernier, une seule fois (400). Content-Length : chiffres seuls,
+// identiques sur tous les champs, et jamais avec Transfer-Encoding (400).
+bool HttpRequestParser::parseFraming() {
+    bool hasEncoding = false;
+    size_t chunkedCount = 0;
+    bool chunkedLast = false;
+    bool otherCoding = false;
+    bool hasLength = false;
+    size_t length = 0;
+    for (size_t i = 0; i < _request.fields.size(); ++i) {
+        const HttpHeaderField& field = _request.fields[i];
+        const char* value = _request.head.data() + field.value.off;
+        if (field.id == HDR_CONTENT_LENGTH) {
+            size_t fieldLength;
+            if (!parseContentLength(value, field.value.len, fieldLength) || (hasLength && fieldLength != length)) {
+                return fail(400);
+            }
+            hasLength = true;
+            length = fieldLength;
+        } else if (field.id == HDR_TRANSFER_ENCODING) {
+            // Liste de codages séparés par des virgules, éventuellement sur plusieurs champs
+            hasEncoding = true;
+            size_t pos = 0;
+            while (pos < field.value.len) {
+                size_t end = pos;
+                while (end < field.value.len && value[end] != ',') {
+                    ++end;
+                }
+                size_t first = pos;
+                size_t last = end;
+                while (first < last && (value[first] == ' ' || value[first] == '\t')) {
+                    ++first;
+                }
+                while (last > first && (value[last - 1] == ' ' || value[last - 1] == '\t')) {
+                    --last;
+                }
+                if (last > first) {
+                    bool chunked = last - first == 7 && strncasecmp(value + first, "chunked", 7) == 0;
+                    chunkedCount += chunked ? 1 : 0;
+                    otherCoding = otherCoding || !chunked;
+                    chunkedLast = chunked;
+                }
+                pos = end + 1;
+            }
+        }
+    }
+    if (hasEncoding) {
+        if (hasLength) {
+            return fail(400);
+        }
+        if (otherCoding) {
+            return fail(501);
+        }
+        if (!chunkedLast || chunkedCount != 1) {
+            return fail(400);
+        }
+        _request.isChunked = true;
+        return true;
+    }
+    _request.isChunked = false;
+    _request.contentLength = hasLength ? length : 0;
+    return true;
+}
+
+// Tête copiée une fois dans la requête puis retirée de la chaîne : le corps est
+// ensuite lu depuis la position 0
+bool HttpRequestParser::finishHead(BufferChain& buffer, size_t headerEnd) {
+    buffer.copyTo(_start, headerEnd - _start, _request.head);
+    buffer.consume(headerEnd);
+    _start = _pos = _scan = 0;
+    _request.indexHeaders();
+
+    if (!parseFraming()) {
+        return false;
+    }
+    if (_request.isChunked) {
+        _state = CHUNK_SIZE;
+        return true;
+    }
+    _remaining = _request.contentLength;
+    _state = BODY;
+    return true;
+}
+
+// Fin de la ligne commençant en 0 (npos si incomplète) ; la recherche reprend en _scan
+size_t HttpRequestParser::findLine(const BufferChain& buffer) {
+    size_t lineEnd = buffer.find("\r\n", 2, _scan);
+    if (lineEnd == std::string::npos && buffer.size() > 1) {
+        _scan = buffer.size() - 1;
+    }
+    return lineEnd;
+}
+
+void HttpRequestParser::setBodyLimit(size_t limit) {
+    _bodyLimit = limit;
+    if (_state == BODY && _bodyLimit && _remaining > _bodyLimit) {
+        fail(413);
+    }
+}
+
+// Fichier sans nom (O_TMPFILE), supprimé par le noyau à sa fermeture ; sinon mkstemp + unlink
+static int openBodyFile() {
+    const char* dir = getenv("TMPDIR");
+    if (!dir || !*dir) {
+        dir = "/tmp";
+    }
+    int fd;
+#ifdef O_TMPFILE
+    fd = open(dir, O_TMPFILE | O_RDWR | O_CLOEXEC, 0600);
+    if (fd != -1) {
+        return fd;
+    }
+#endif
+    std::string path = std::string(dir) + "/webserv_body_XXXXXX";
+    std::vector<char> name(path.begin(), path.end());
+    name.push_back('\0');
+    fd = mkstemp(&name[0]);
+    if (fd != -1) {
+        unlink(&name[0]);
+        fcntl(fd, F_SETFD, FD_CLOEXEC);
+    }
+    return fd;
+}
+
+// Passage en fichier : ce qui était en mémoire y est recopié puis libéré
+bool HttpRequestParser::spillBody() {
+    int fd = openBodyFile();
+    if (fd == -1) {
+        return fail(500);
+    }
+    _request.bodyFd = fd;
+    _request.bodyFileSize = 0;
+    size_t written = 0;
+    while (written < _request.body.size()) {
+        ssize_t n = write(fd, _request.body.data() + written, _request.body.size() - written);
+        if (n <= 0) {
+            if (n == -1 && errno == EINTR) {
+                continue;
+            }
+            return fail(500);
+        }
+        written += n;
+    }
+    _request.bodyFileSize = written;
+    std::string().swap(_request.body);
+    return true;
+}
+
+void HttpRequestParser::setUpload(MultipartUpload* upload) {
+    delete _request.upload;
+    _request.upload = upload;
+}
+
+// Verse len octets de tête de chaîne dans le corps (upload multipart, mémoire ou
+// fichier) et les consomme
+bool HttpRequestParser::storeBody(BufferChain& buffer, size_t len) {
+    _bodyReceived += len;
+    if (_request.upload) {
+        // Bloc par bloc, sans copie : l'analyse multipart écrit directement les fichiers
+        while (len > 0) {
+            const char* data;
+            size_t n = buffer.contiguous(0, data);
+            if (n > len) {
+                n = len;
+            }
+            if (!_request.upload->feed(data, n)) {
+                return fail(500);
+            }
+            buffer.consume(n);
+            len -= n;
+        }
+        return true;
+    }
+    if (_request.bodyFd == -1 && _bodyBufferSize && _request.body.size() + len > _bodyBufferSize) {
+        if (!spillBody()) {
+            return false;
+        }
+    }
+    if (_request.bodyFd == -1) {
+        buffer.copyTo(0, len, _request.body);
+        buffer.consume(len);
+        return true;
+    }
+    if (!buffer.writeTo(_request.bodyFd, len)) {
+        return fail(500);
+    }
+    _request.bodyFileSize += len;
+    return true;
+}
+
+bool HttpRequestParser::fail(int status) {
+    _state = FAILED;
+    _errorStatus = status;
+    return false;
+}
+
+// Verse le corps disponible dans request.body et le retire de la chaîne. Les chunks
+// sont décodés au passage ; la limite est vérifiée avant de copier les données.
+bool HttpRequestParser::advanceBody(BufferChain& buffer) {
+    while (true) {
+        switch (_state) {
+        case BODY: {
+            if (_bodyLimit && _remaining > _bodyLimit) {
+                return fail(413);
+            }
+            size_t n = (_remaining < buffer.size()) ? _remaining : buffer.size();
+            if (n > 0 && !storeBody(buffer, n)) {
+                return false;
+            }
+            _remaining -= n;
+            if (_remaining > 0) {
+                return false;
+            }
+            _state = COMPLETE;
+            return true;
+        }
+        case CHUNK_SIZE: {
+            size_t lineEnd = findLine(buffer);
+            if (lineEnd == std::string::npos) {
+                return (buffer.size() > MAX_CHUNK_LINE) ? fail(400) : false;
+            }
+            // Ligne courte : seule elle est copiée pour être analysée
+            std::string sizeLine;
+            buffer.copyTo(0, (lineEnd > MAX_CHUNK_LINE) ? MAX_CHUNK_LINE : lineEnd, sizeLine);
+            size_t chunkSize;
+            if (!parseChunkSize(sizeLine.data(), sizeLine.size(), chunkSize)) {
+                return fail(400);
+            }
+            if (_bodyLimit && (chunkSize > _bodyLimit || _bodyReceived > _bodyLimit - chunkSize)) {
+                return fail(413);
+            }
+            buffer.consume(lineEnd + 2);
+            _scan = 0;
+            _remaining = chunkSize;
+            _state = (chunkSize == 0) ? TRAILERS : CHUNK_DATA;
+            break;
+        }
+        case CHUNK_DATA: {
+            size_t n = (_remaining < buffer.size()) ? _remaining : buffer.size();
+            if (n > 0 && !storeBody(buffer, n)) {
+                return false;
+            }
+            _remaining -= n;
+            if (_remaining > 0) {
+                return false;
+            }
+            _state = CHUNK_DATA_END;
+            break;
+        }
+        case CHUNK_DATA_END:
+            if (buffer.size() < 2) {
+                return false;
+            }
+            if (buffer.at(0) != '\r' || buffer.at(1) != '\n') {
+                return fail(400);
+            }
+            buffer.consume(2);
+            _state = CHUNK_SIZE;
+            break;
+        case TRAILERS: {
+            // Trailers ignorés, une ligne à la fois ; la ligne vide termine la requête
+            size_t lineEnd = findLine(buffer);
+            if (lineEnd == std::string::npos) {
+                return (buffer.size() > MAX_TRAILER_LINE) ? fail(400) : false;
+            }
+            buffer.consume(lineEnd + 2);
+            _scan = 0;
+            if (lineEnd == 0) {
+                _state = COMPLETE;
+                return true;
+            }
+            break;
+        }
+        default:
+            return _state == COMPLETE;
+        }
+    }
+}
+
+HttpRequestParser::Status HttpRequestParser::advance(BufferChain& buffer) {
+    if (_state == COMPLETE) {
+        return PARSE_COMPLETE;
+    }
+    if (_state == FAILED) {
+        return PARSE_ERROR;
+    }
+
+    // Tête : un seul passage relève les \r et le premier ':' de chaque ligne ; chaque octet
+    // n'est examiné qu'une fois, même sur plusieurs lectures. ByteScan cherche les deux
+    // jusqu'au ':' du champ, memchr seulement le \r ensuite (et sur la ligne de requête)
+    if (_state == REQUEST_LINE || _state == HEADERS) {
+        while (true) {
+            size_t from = (_scan > _pos) ? _scan : _pos;
+            bool wantColon = (_state == HEADERS && _colon == std::string::npos);
+            size_t hit = wantColon ? buffer.findAny('\r', ':', from) : buffer.findByte('\r', from);
+            if (hit == std::string::npos) {
+                _scan = buffer.size();
+                return checkHeadSize(buffer.size()) ? PARSE_INCOMPLETE : PARSE_ERROR;
+            }
+            if (wantColon && buffer.at(hit) == ':') {
+                _colon = hit;
+                _scan = hit + 1;
+                continue;
+            }
+            if (hit + 1 >= buffer.size()) {
+                _scan = hit; // \r final : le \n peut arriver avec le prochain paquet
+                return checkHeadSize(buffer.size()) ? PARSE_INCOMPLETE : PARSE_ERROR;
+            }
+            _scan = hit + 1;
+            if (buffer.at(hit + 1) != '\n') {
+                continue;
+            }
+            size_t lineEnd = hit;
+            if (!checkHeadSize(lineEnd)) {
+                return PARSE_ERROR;
+            }
+            if (_state == REQUEST_LINE) {
+                if (parseRequestLine(buffer, lineEnd)) {
+                    _state = HEADERS;
+                    _pos = lineEnd + 2;
+                } else if (_state == FAILED) {
+                    return PARSE_ERROR;
+                }
+                continue;
+            }
+            if (lineEnd == _pos) {
+                if (!finishHead(buffer, lineEnd + 2)) {
+                    return PARSE_ERROR; // Cadrage refusé : la connexion sera fermée
+                }
+                // Rendre la main avant de lire le corps : l'appelant fixe la limite
+                return PARSE_HEAD_READY;
+            }
+            if (!parseHeaderLine(buffer, lineEnd)) {
+                return PARSE_ERROR;
+            }
+            _pos = lineEnd + 2;
+            _colon = std::string::npos;
+        }
+    }
+
+    if (advanceBody(buffer)) {
+        return PARSE_COMPLETE;
+    }
+    return (_state == FAILED) ? PARSE_ERROR : PARSE_INCOMPLETE;
+}
+
+// La tête et le corps ont déjà été copiés à l'arrivée : simple échange
+void HttpRequestParser::take(HttpRequest& out) {
+    out.clear();
+    out.head.swap(_request.head);
+    out.body.swap(_request.body);
+    out.bodyFd = _request.bodyFd;
+    out.bodyFileSize = _request.bodyFileSize;
+    out.upload = _request.upload;
+    _request.bodyFd = -1;
+    _request.upload = NULL;
+    out.method = _request.method;
+    out.target = _request.target;
+    out.version = _request.version;
+    out.fields.swap(_request.fields);
+    memcpy(out.known, _request.known, sizeof(out.known));
+    out.isChunked = _request.isChunked;
+    out.contentLength = _request.isChunked ? _bodyReceived : _request.contentLength;
+    reset();
+}
@@ -0,0 +1,149 @@
+#ifndef HTTPREQUEST_HPP
+#define HTTPREQUEST_HPP
+
+#include <string>
+#include <vector>
+#include "BufferChain.hpp"
+#include "HttpHeaders.hpp"
+
+class MultipartUpload;
+
+// Portion de HttpRequest::head (offset + longueur)
+struct HttpSpan {
+    size_t off;
+    size_t len;
+
+    HttpSpan() : off(0), len(0) {}
+    HttpSpan(size_t o, size_t l) : off(o), len(l) {}
+};
+
+struct HttpHeaderField {
+    HttpSpan name;
+    HttpSpan value;     // Sans les espaces de début et de fin
+    HttpHeaderId id;    // HDR_UNKNOWN si le nom n'est pas dans HTTP_HEADERS
+};
+
+// Requête analysée : la ligne de requête et les en-têtes restent dans head, les
+// champs ne sont que des positions. Les recherches d'en-têtes ignorent la casse ; un
+// en-tête connu est retrouvé par known[id], seuls les inconnus sont parcourus.
+// Un corps plus grand que client_body_buffer_size est dans bodyFd (fichier temporaire
+// sans nom, fermé avec la requête) et body reste vide. Un upload multipart analysé à la
+// réception n'est ni dans body ni dans bodyFd : ses fichiers sont dans upload.
+class HttpRequest {
+private:
+    HttpRequest(const HttpRequest&);
+    HttpRequest& operator=(const HttpRequest&);
+
+public:
+    std::string head;                       // Ligne de requête + en-têtes, \r\n\r\n compris
+    std::string body;                       // Corps décodé (chunks déjà réassemblés)
+    int bodyFd;                             // -1 : corps en mémoire dans body
+    size_t bodyFileSize;
+    MultipartUpload* upload;                // Possédé ; NULL si le corps est stocké tel quel
+    HttpSpan method;
+    HttpSpan target;                        // Chemin et query string
+    HttpSpan version;
+    std::vector<HttpHeaderField> fields;
+    int known[HDR_COUNT];                   // Indice dans fields de la 1re occurrence, -1 si absent
+    bool isChunked;
+    size_t contentLength;
+
+    HttpRequest();
+    ~HttpRequest();
+
+    std::string str(const HttpSpan& span) const { return head.substr(span.off, span.len); }
+    std::string getMethod() const { return str(method); }
+    std::string getTarget() const { return str(target); }
+    std::string getVersion() const { return str(version); }
+    std::string getFieldName(size_t i) const { return str(fields[i].name); }
+    std::string getFieldValue(size_t i) const { return str(fields[i].value); }
+
+    const HttpHeaderField* findHeader(HttpHeaderId id) const { return (known[id] < 0) ? NULL : &fields[known[id]]; }
+    const HttpHeaderField* findHeader(const char* name) const;
+    bool hasHeader(HttpHeaderId id) const { return known[id] >= 0; }
+    bool hasHeader(const char* name) const { return findHeader(name) != NULL; }
+    std::string getHeader(HttpHeaderId id) const; // "" si absent
+    std::string getHeader(const char* name) const;
+    void indexHeaders();                    // Reconnaît les noms de fields et remplit known
+    size_t bodyLength() const { return (bodyFd == -1) ? body.size() : bodyFileSize; }
+    bool hasBodyFile() const { return bodyFd != -1; }
+    void clear();
+};
+
+// Analyse incrémentale d'une requête dans la chaîne de réception d'un client : chaque
+// appel à advance() reprend où le précédent s'est arrêté, ligne par ligne pour la tête.
+// A la fin de la tête, celle-ci est copiée dans la requête et retirée de la chaîne ;
+// le corps (Content-Length ou chunks décodés) est ensuite versé dans request.body au fil
+// des lectures, ou dans un fichier temporaire au-delà du seuil, et la chaîne libérée
+// derrière lui.
+class HttpRequestParser {
+public:
+    enum State {
+        REQUEST_LINE,
+        HEADERS,
+        BODY,
+        CHUNK_SIZE,         // Ligne "taille[;extensions]"
+        CHUNK_DATA,         // _remaining octets de données
+        CHUNK_DATA_END,     // \r\n qui suit les données
+        TRAILERS,           // Trailers éventuels puis ligne vide
+        COMPLETE,
+        FAILED
+    };
+
+    enum Status {
+        PARSE_INCOMPLETE,
+        PARSE_HEAD_READY,   // Tête complète, corps pas encore lu : fixer la limite du corps
+        PARSE_COMPLETE,
+        PARSE_ERROR         // Voir getErrorStatus()
+    };
+
+private:
+    State _state;
+    size_t _start;          // Début de la requête (CRLF parasites ignorés avant)
+    size_t _pos;            // Début de la ligne en cours
+    size_t _scan;           // Recherche de \r\n reprise ici : chaque octet n'est examiné qu'une fois
+    size_t _colon;          // Premier ':' de la ligne d'en-tête en cours (npos avant)
+    size_t _remaining;      // Octets du corps (ou du chunk) encore attendus
+    size_t _bodyLimit;      // 0 : pas de limite
+    size_t _bodyBufferSize; // Seuil de passage en fichier temporaire (0 : toujours en mémoire)
+    size_t _bodyReceived;   // Octets de corps décodés, où qu'ils aient été versés
+    size_t _headerBufferSize;       // Fenêtre de lecture tant que la tête tient dedans
+    size_t _largeHeaderBuffers;     // La tête entière : au plus _largeHeaderBuffers * _largeHeaderBufferSize
+    size_t _largeHeaderBufferSize;  // Une ligne de tête : au plus _largeHeaderBufferSize
+    int _errorStatus;
+    HttpRequest _request;   // Positions relevées, relatives à _start
+    std::string _line;      // Ligne de tête à cheval sur deux blocs, recopiée
+
+    const char* lineData(const BufferChain& buffer, size_t pos, size_t lineEnd);
+    bool parseRequestLine(const BufferChain& buffer, size_t lineEnd);
+    bool parseHeaderLine(const BufferChain& buffer, size_t lineEnd);
+    bool finishHead(BufferChain& buffer, size_t headerEnd);
+    bool parseFraming();
+    size_t findLine(const BufferChain& buffer);
+    bool fail(int status);
+    bool checkHeadSize(size_t end);
+    bool advanceBody(BufferChain& buffer);
+    bool spillBody();
+    bool storeBody(BufferChain& buffer, size_t len);
+
+public:
+    HttpRequestParser();
+
+    State getState() const { return _state; }
+    int getErrorStatus() const { return _errorStatus; }
+    const HttpRequest& getRequest() const { return _request; } // Tête valide dès PARSE_HEAD_READY
+    size_t getBufferedSize() const { return _request.head.size() + _request.body.size(); } // Hors fichier temporaire
+    void setBodyLimit(size_t limit);    // Content-Length déjà trop grand : échec (413) immédiat
+    void setBodyBufferSize(size_t size) { _bodyBufferSize = size; }
+    void setUpload(MultipartUpload* upload); // Le corps ira à upload (possédé par la requête)
+    // Limites de tête (client_header_buffer_size, large_client_header_buffers) : conservées
+    // d'une requête à l'autre de la connexion
+    void setHeaderLimits(size_t bufferSize, size_t largeBuffers, size_t largeBufferSize);
+    size_t readWindow(const BufferChain& buffer) const; // Octets à lire au plus (0 : sans limite)
+
+    Status advance(BufferChain& buffer);
+    void take(HttpRequest& out);   // Transfère la requête complète (sans copie) et réarme l'analyseur
+    void reset();
+};
+
+#endif
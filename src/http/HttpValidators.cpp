@@ -0,0 +1,184 @@
+#include "HttpValidators.hpp"
+#include "HttpRequest.hpp"
+#include <cstdio>
+#include <cstring>
+
+std::string httpDate(time_t when) {
+    struct tm gmtBuf;
+    struct tm* gmt = gmtime_r(&when, &gmtBuf); // Réentrant : une boucle epoll par thread
+    char buffer[64];
+    strftime(buffer, sizeof(buffer), "%a, %d %b %Y %H:%M:%S GMT", gmt);
+    return std::string(buffer);
+}
+
+// Noms anglais imposés par la RFC, comparés à la main : strptime (%a, %b) dépendrait de
+// la locale du processus
+static const char* const MONTHS[] = { "Jan", "Feb", "Mar", "Apr", "May", "Jun",
+                                      "Jul", "Aug", "Sep", "Oct", "Nov", "Dec" };
+static const char* const DAYS[] = { "Sun", "Mon", "Tue", "Wed", "Thu", "Fri", "Sat" };
+static const char* const WEEKDAYS[] = { "Sunday", "Monday", "Tuesday", "Wednesday",
+                                        "Thursday", "Friday", "Saturday" };
+
+// Indice du nom lu en p (p avancé après), -1 si aucun
+static int readName(const char*& p, const char* const* names, int count) {
+    for (int i = 0; i < count; ++i) {
+        size_t len = strlen(names[i]);
+        if (strncmp(p, names[i], len) == 0) {
+            p += len;
+            return i;
+        }
+    }
+    return -1;
+}
+
+static bool readLiteral(const char*& p, const char* literal) {
+    size_t len = strlen(literal);
+    if (strncmp(p, literal, len) != 0) {
+        return false;
+    }
+    p += len;
+    return true;
+}
+
+// Exactement digits chiffres
+static bool readNumber(const char*& p, int digits, int& out) {
+    out = 0;
+    for (int i = 0; i < digits; ++i) {
+        if (p[i] < '0' || p[i] > '9') {
+            return false;
+        }
+        out = out * 10 + (p[i] - '0');
+    }
+    p += digits;
+    return true;
+}
+
+// "HH:MM:SS"
+static bool readTime(const char*& p, struct tm& tm) {
+    return readNumber(p, 2, tm.tm_hour) && readLiteral(p, ":") && readNumber(p, 2, tm.tm_min)
+        && readLiteral(p, ":") && readNumber(p, 2, tm.tm_sec);
+}
+
+// Sun, 06 Nov 1994 08:49:37 GMT
+static bool readImfFixdate(const char* p, struct tm& tm) {
+    int year;
+    if (readName(p, DAYS, 7) < 0 || !readLiteral(p, ", ") || !readNumber(p, 2, tm.tm_mday) || !readLiteral(p, " ")
+        || (tm.tm_mon = readName(p, MONTHS, 12)) < 0 || !readLiteral(p, " ") || !readNumber(p, 4, year)
+        || !readLiteral(p, " ") || !readTime(p, tm) || !readLiteral(p, " GMT")) {
+        return false;
+    }
+    tm.tm_year = year - 1900;
+    return *p == '\0';
+}
+
+// Sunday, 06-Nov-94 08:49:37 GMT ; année sur deux chiffres : 70-99 pour 19xx
+static bool readRfc850Date(const char* p, struct tm& tm) {
+    int year;
+    if (readName(p, WEEKDAYS, 7) < 0 || !readLiteral(p, ", ") || !readNumber(p, 2, tm.tm_mday) || !readLiteral(p, "-")
+        || (tm.tm_mon = readName(p, MONTHS, 12)) < 0 || !readLiteral(p, "-") || !readNumber(p, 2, year)
+        || !readLiteral(p, " ") || !readTime(p, tm) || !readLiteral(p, " GMT")) {
+        return false;
+    }
+    tm.tm_year = (year < 70) ? year + 100 : year;
+    return *p == '\0';
+}
+
+// Sun Nov  6 08:49:37 1994 (jour sur deux positions, complété par une espace)
+static bool readAsctimeDate(const char* p, struct tm& tm) {
+    int year;
+    if (readName(p, DAYS, 7) < 0 || !readLiteral(p, " ") || (tm.tm_mon = readName(p, MONTHS, 12)) < 0
+        || !readLiteral(p, " ")) {
+        return false;
+    }
+    bool day;
+    if (*p == ' ') {
+        ++p;
+        day = readNumber(p, 1, tm.tm_mday);
+    } else {
+        day = readNumber(p, 2, tm.tm_mday);
+    }
+    if (!day || !readLiteral(p, " ") || !readTime(p, tm) || !readLiteral(p, " ") || !readNumber(p, 4, year)) {
+        return false;
+    }
+    tm.tm_year = year - 1900;
+    return *p == '\0';
+}
+
+// Les deux formats obsolètes restent acceptés en réception
+bool parseHttpDate(const std::string& value, time_t& out) {
+    struct tm tm;
+    memset(&tm, 0, sizeof(tm));
+    const char* p = value.c_str();
+    if (!readImfFixdate(p, tm) && !readRfc850Date(p, tm) && !readAsctimeDate(p, tm)) {
+        return false;
+    }
+    if (tm.tm_mday < 1 || tm.tm_mday > 31 || tm.tm_hour > 23 || tm.tm_min > 59 || tm.tm_sec > 60) {
+        return false;
+    }
+    out = timegm(&tm);
+    return out != static_cast<time_t>(-1);
+}
+
+std::string fileETag(const struct stat& st) {
+    char buffer[80];
+    snprintf(buffer, sizeof(buffer), "\"%lx-%lx-%lx\"", static_cast<unsigned long>(st.st_ino),
+             static_cast<unsigned long>(st.st_size), static_cast<unsigned long>(st.st_mtime));
+    return std::string(buffer);
+}
+
+// Liste d'entity-tags ("*" ou W/"a", "b"...) : vrai si l'une correspond à etag. La
+// comparaison forte exclut tout tag faible, la faible ignore le préfixe W/.
+static bool etagListMatches(const std::string& list, const std::string& etag, bool strong) {
+    bool etagWeak = etag.compare(0, 2, "W/") == 0;
+    std::string opaque = etagWeak ? etag.substr(2) : etag;
+    size_t pos = 0;
+    while (pos < list.size()) {
+        char c = list[pos];
+        if (c == ' ' || c == '\t' || c == ',') {
+            ++pos;
+            continue;
+        }
+        if (c == '*') {
+            return true;
+        }
+        bool weak = list.compare(pos, 2, "W/") == 0;
+        if (weak) {
+            pos += 2;
+        }
+        if (pos >= list.size() || list[pos] != '"') {
+            return false; // Liste mal formée : aucune correspondance
+        }
+        size_t close = list.find('"', pos + 1);
+        if (close == std::string::npos) {
+            return false;
+        }
+        if (list.compare(pos, close + 1 - pos, opaque) == 0 && (!strong || (!weak && !etagWeak))) {
+            return true;
+        }
+        pos = close + 1;
+    }
+    return false;
+}
+
+int checkPreconditions(const HttpRequest& request, time_t lastModified, const std::string& etag) {
+    time_t date;
+    const HttpHeaderField* ifMatch = request.findHeader(HDR_IF_MATCH);
+    if (ifMatch) {
+        if (!etagListMatches(request.str(ifMatch->value), etag, true)) {
+            return 412;
+        }
+    } else if (request.hasHeader(HDR_IF_UNMODIFIED_SINCE)
+               && parseHttpDate(request.getHeader(HDR_IF_UNMODIFIED_SINCE), date) && lastModified > date) {
+        return 412;
+    }
+
+    const HttpHeaderField* ifNoneMatch = request.findHeader(HDR_IF_NONE_MATCH);
+    if (ifNoneMatch) {
+        return etagListMatches(request.str(ifNoneMatch->value), etag, false) ? 304 : 0;
+    }
+    if (request.hasHeader(HDR_IF_MODIFIED_SINCE)
+        && parseHttpDate(request.getHeader(HDR_IF_MODIFIED_SINCE), date) && lastModified <= date) {
+        return 304;
+    }
+    return 0;
+}
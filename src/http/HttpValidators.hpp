@@ -0,0 +1,23 @@
+#ifndef HTTPVALIDATORS_HPP
+#define HTTPVALIDATORS_HPP
+
+#include <string>
+#include <ctime>
+#include <sys/stat.h>
+
+class HttpRequest;
+
+// Validateurs d'un fichier statique et requêtes conditionnelles (RFC 9110, section 13).
+// L'ETag est fort, comme celui de nginx : inode, taille et date de modification, sans
+// lire le contenu. Un fichier réécrit dans la même seconde, à la même taille et sur le
+// même inode garderait son ETag ; ce cas est accepté.
+
+std::string httpDate(time_t when);                          // IMF-fixdate
+bool parseHttpDate(const std::string& value, time_t& out);  // IMF-fixdate, RFC 850 ou asctime, hors locale
+std::string fileETag(const struct stat& st);                // "inode-taille-mtime"
+
+// If-Match / If-Unmodified-Since puis If-None-Match / If-Modified-Since, dans l'ordre
+// de la RFC. Renvoie 0 (servir la représentation), 304 ou 412. GET et HEAD seulement.
+int checkPreconditions(const HttpRequest& request, time_t lastModified, const std::string& etag);
+
+#endif
@@ -0,0 +1,282 @@
+#include "MultipartUpload.hpp"
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#define MAX_PART_HEADERS 8192
+
+MultipartUpload::MultipartUpload(const std::string& boundary, const std::string& uploadDir)
+    : _state(PREAMBLE), _uploadDir(uploadDir), _delimiter("\r\n--" + boundary),
+      _carry("\r\n"), _fd(-1), _ioError(false) {
+    // Le premier délimiteur n'a pas de \r\n devant : le préambule commence comme s'il en avait un
+    size_t m = _delimiter.size();
+    for (size_t i = 0; i < 256; ++i) {
+        _skip[i] = m;
+    }
+    for (size_t k = 0; k + 1 < m; ++k) {
+        _skip[static_cast<unsigned char>(_delimiter[k])] = m - 1 - k;
+    }
+}
+
+MultipartUpload::~MultipartUpload() {
+    // Fichiers non nommés : O_TMPFILE disparaît à la fermeture, le repli est supprimé
+    for (size_t i = 0; i < _files.size(); ++i) {
+        if (_files[i].fd != -1) {
+            close(_files[i].fd);
+        }
+        if (!_files[i].tempPath.empty()) {
+            unlink(_files[i].tempPath.c_str());
+        }
+    }
+}
+
+std::string MultipartUpload::boundaryFrom(const std::string& contentType) {
+    size_t pos = contentType.find("boundary=");
+    if (pos == std::string::npos) {
+        return "";
+    }
+    std::string boundary = contentType.substr(pos + 9);
+    boundary = boundary.substr(0, boundary.find(';'));
+    if (boundary.length() >= 2 && boundary[0] == '"' && boundary[boundary.length() - 1] == '"') {
+        boundary = boundary.substr(1, boundary.length() - 2);
+    }
+    return boundary;
+}
+
+// Boyer-Moore-Horspool : le délimiteur est long (boundary de 30 à 70 octets), les
+// décalages sautent la plupart des octets des données
+size_t MultipartUpload::search(const char* data, size_t len) const {
+    size_t m = _delimiter.size();
+    if (len < m) {
+        return std::string::npos;
+    }
+    const char* pattern = _delimiter.data();
+    char lastPattern = pattern[m - 1];
+    size_t i = 0;
+    while (i <= len - m) {
+        char last = data[i + m - 1];
+        if (last == lastPattern && memcmp(data + i, pattern, m - 1) == 0) {
+            return i;
+        }
+        i += _skip[static_cast<unsigned char>(last)];
+    }
+    return std::string::npos;
+}
+
+bool MultipartUpload::emit(const char* data, size_t len) {
+    if (_state != PART_DATA || _fd == -1) {
+        return true; // Préambule ou champ de formulaire : ignoré
+    }
+    while (len > 0) {
+        ssize_t n = write(_fd, data, len);
+        if (n <= 0) {
+            if (n == -1 && errno == EINTR) {
+                continue;
+            }
+            _ioError = true;
+            return false;
+        }
+        data += n;
+        len -= n;
+    }
+    return true;
+}
+
+// Données jusqu'au prochain délimiteur. Les derniers octets d'un paquet qui peuvent
+// commencer un délimiteur restent dans _carry et sont recollés au paquet suivant.
+bool MultipartUpload::consumeData(const char* data, size_t len, size_t& used) {
+    size_t m = _delimiter.size();
+    used = 0;
+    if (!_carry.empty()) {
+        size_t take = (len < m - 1) ? len : m - 1;
+        std::string joint = _carry;
+        joint.append(data, take);
+        size_t pos = search(joint.data(), joint.size());
+        if (pos != std::string::npos) {
+            used = pos + m - _carry.size();
+            _carry.clear();
+            if (!emit(joint.data(), pos)) {
+                return false;
+            }
+            finishPart();
+            _state = BOUNDARY_END;
+            return true;
+        }
+        if (take < m - 1) {
+            // Trop peu d'octets pour trancher : garder la fin pour le prochain paquet
+            size_t keep = (joint.size() < m - 1) ? joint.size() : m - 1;
+            _carry = joint.substr(joint.size() - keep);
+            used = len;
+            return emit(joint.data(), joint.size() - keep);
+        }
+        std::string flushed;
+        flushed.swap(_carry);
+        if (!emit(flushed.data(), flushed.size())) {
+            return false;
+        }
+    }
+
+    size_t pos = search(data, len);
+    if (pos != std::string::npos) {
+        used = pos + m;
+        if (!emit(data, pos)) {
+            return false;
+        }
+        finishPart();
+        _state = BOUNDARY_END;
+        return true;
+    }
+    size_t keep = (len < m - 1) ? len : m - 1;
+    _carry.assign(data + len - keep, keep);
+    used = len;
+    return emit(data, len - keep);
+}
+
+int MultipartUpload::createFile(SavedFile& file) {
+#ifdef O_TMPFILE
+    // Sans nom dans le répertoire d'upload même : linkat au commit, sans copie
+    file.fd = open(_uploadDir.c_str(), O_TMPFILE | O_WRONLY | O_CLOEXEC, 0644);
+    if (file.fd != -1) {
+        return file.fd;
+    }
+#endif
+    std::string path = _uploadDir + "/.upload_XXXXXX";
+    std::vector<char> name(path.begin(), path.end());
+    name.push_back('\0');
+    file.fd = mkstemp(&name[0]);
+    if (file.fd != -1) {
+        fcntl(file.fd, F_SETFD, FD_CLOEXEC);
+        fchmod(file.fd, 0644);
+        file.tempPath = &name[0];
+    }
+    return file.fd;
+}
+
+// En-têtes de partie : seul le filename de Content-Disposition est utilisé
+bool MultipartUpload::startPart() {
+    _fd = -1;
+    size_t pos = _headers.find("filename=\"");
+    if (pos == std::string::npos) {
+        return true;
+    }
+    pos += 10;
+    size_t end = _headers.find('"', pos);
+    if (end == std::string::npos) {
+        return true;
+    }
+    SavedFile file;
+    file.fd = -1;
+    file.name = _headers.substr(pos, end - pos);
+    // Sécuriser le nom de fichier (éviter path traversal)
+    if (file.name.empty() || file.name.find("..") != std::string::npos || file.name.find('/') != std::string::npos) {
+        return true;
+    }
+    if (createFile(file) == -1) {
+        _ioError = true;
+        return false;
+    }
+    _files.push_back(file);
+    _fd = file.fd;
+    return true;
+}
+
+void MultipartUpload::finishPart() {
+    _fd = -1;
+}
+
+bool MultipartUpload::feed(const char* data, size_t len) {
+    while (len > 0) {
+        switch (_state) {
+        case PREAMBLE:
+        case PART_DATA: {
+            size_t used;
+            if (!consumeData(data, len, used)) {
+                return false;
+            }
+            data += used;
+            len -= used;
+            break;
+        }
+        case BOUNDARY_END: {
+            size_t take = (len < 2 - _carry.size()) ? len : 2 - _carry.size();
+            _carry.append(data, take);
+            data += take;
+            len -= take;
+            if (_carry.size() < 2) {
+                return true;
+            }
+            if (_carry == "\r\n") {
+                _state = PART_HEADERS;
+                _headers = "\r\n"; // Bloc d'en-têtes vide = "\r\n" immédiat
+            } else if (_carry == "--") {
+                _state = EPILOGUE;
+            } else {
+                _state = FAILED;
+            }
+            _carry.clear();
+            break;
+        }
+        case PART_HEADERS: {
+            size_t old = _headers.size();
+            size_t take = MAX_PART_HEADERS + 4 - old;
+            if (take > len) {
+                take = len;
+            }
+            _headers.append(data, take);
+            size_t end = _headers.find("\r\n\r\n", (old > 3) ? old - 3 : 0);
+            if (end == std::string::npos) {
+                if (_headers.size() >= MAX_PART_HEADERS + 4) {
+                    _state = FAILED;
+                }
+                data += take;
+                len -= take;
+                break;
+            }
+            size_t used = end + 4 - old;
+            data += used;
+            len -= used;
+            _headers = _headers.substr(2, end - 2);
+            _state = PART_DATA;
+            if (!startPart()) {
+                return false;
+            }
+            break;
+        }
+        case EPILOGUE:
+        case FAILED:
+            return true;
+        }
+    }
+    return true;
+}
+
+size_t MultipartUpload::commit() {
+    size_t committed = 0;
+    for (size_t i = 0; i < _files.size(); ++i) {
+        SavedFile& file = _files[i];
+        std::string target = _uploadDir + "/" + file.name;
+        bool ok;
+        if (file.tempPath.empty()) {
+            // Nom donné au fichier O_TMPFILE ; un fichier existant est remplacé
+            char procPath[64];
+            snprintf(procPath, sizeof(procPath), "/proc/self/fd/%d", file.fd);
+            unlink(target.c_str());
+            ok = linkat(AT_FDCWD, procPath, AT_FDCWD, target.c_str(), AT_SYMLINK_FOLLOW) == 0;
+        } else {
+            ok = rename(file.tempPath.c_str(), target.c_str()) == 0;
+            if (ok) {
+                file.tempPath.clear();
+            }
+        }
+        close(file.fd);
+        file.fd = -1;
+        if (ok) {
+            ++committed;
+        }
+    }
+    return committed;
+}
@@ -0,0 +1,65 @@
+#ifndef MULTIPARTUPLOAD_HPP
+#define MULTIPARTUPLOAD_HPP
+
+#include <string>
+#include <vector>
+#include <cstddef>
+
+// Analyse incrémentale d'un corps multipart/form-data, alimentée au fil des lectures.
+// Chaque partie avec filename est écrite dès réception dans un fichier sans nom du
+// répertoire d'upload (O_TMPFILE) ; commit() leur donne leur nom une fois la requête
+// acceptée, sinon ils disparaissent à la destruction. Mémoire : les en-têtes d'une
+// partie et au plus un délimiteur en attente, quelle que soit la taille des fichiers.
+class MultipartUpload {
+public:
+    enum State {
+        PREAMBLE,           // Avant le premier délimiteur
+        BOUNDARY_END,       // "\r\n" (partie suivante) ou "--" (fin) après un délimiteur
+        PART_HEADERS,
+        PART_DATA,
+        EPILOGUE,           // Après le délimiteur final : ignoré
+        FAILED              // Cadrage invalide : le reste est ignoré, 400 au traitement
+    };
+
+private:
+    struct SavedFile {
+        int fd;
+        std::string name;
+        std::string tempPath;   // Repli sans O_TMPFILE : fichier caché renommé au commit
+    };
+
+    State _state;
+    std::string _uploadDir;
+    std::string _delimiter;         // "\r\n--" + boundary
+    size_t _skip[256];              // Table de décalage Boyer-Moore-Horspool
+    std::string _carry;             // Fin d'un paquet qui peut commencer un délimiteur
+    std::string _headers;           // En-têtes de la partie en cours
+    int _fd;                        // Fichier de la partie en cours (-1 : champ ignoré)
+    std::vector<SavedFile> _files;
+    bool _ioError;
+
+    MultipartUpload(const MultipartUpload&);
+    MultipartUpload& operator=(const MultipartUpload&);
+
+    size_t search(const char* data, size_t len) const;
+    bool consumeData(const char* data, size_t len, size_t& used);
+    bool emit(const char* data, size_t len);
+    bool startPart();
+    void finishPart();
+    int createFile(SavedFile& file);
+
+public:
+    MultipartUpload(const std::string& boundary, const std::string& uploadDir);
+    ~MultipartUpload();
+
+    // Extrait le boundary d'un Content-Type multipart/form-data ("" si absent)
+    static std::string boundaryFrom(const std::string& contentType);
+
+    bool feed(const char* data, size_t len);    // false : erreur d'écriture disque
+    bool isComplete() const { return _state == EPILOGUE; }
+    bool isMalformed() const { return _state == FAILED; }
+    size_t fileCount() const { return _files.size(); }
+    size_t commit();                            // Nomme les fichiers reçus ; renvoie leur nombre
+};
+
+#endif
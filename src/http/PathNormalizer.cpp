@@ -0,0 +1,96 @@
+#include "PathNormalizer.hpp"
+#include "ByteScan.hpp"
+
+static int hexValue(char c) {
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+    return -1;
+}
+
+// Cas courant : sauts vectorisés de '/' en '/', seul l'octet qui suit chaque '/' est examiné
+bool PathNormalizer::isCanonical(const char* path, size_t len) {
+    const char* end = path + len;
+    const char* p = path;
+    while ((p = ByteScan::findAny(p, end, '%', '/')) != end) {
+        if (*p == '%') {
+            return false;
+        }
+        ++p;
+        if (p != end && (*p == '/' || *p == '.')) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Les octets décodés passent par le même automate que les autres : un "%2F" sépare
+// des segments comme un '/', "%2E%2E" est un "..". out[seg..] est le segment en cours.
+PathNormalizer::Result PathNormalizer::normalize(const std::string& raw, std::string& out) {
+    const char* p = raw.data();
+    size_t len = raw.size();
+    if (isCanonical(p, len)) {
+        out = raw;
+        return PATH_OK;
+    }
+    out.assign(1, '/');
+    out.reserve(len);
+    size_t seg = 1;
+    size_t i = 0;
+    while (true) {
+        bool end = (i == len);
+        if (!end) {
+            char c = p[i++];
+            if (c == '%') {
+                int high = (i + 1 < len) ? hexValue(p[i]) : -1;
+                int low = (high >= 0) ? hexValue(p[i + 1]) : -1;
+                if (low < 0 || (high == 0 && low == 0)) {
+                    return PATH_INVALID;
+                }
+                c = static_cast<char>(high * 16 + low);
+                i += 2;
+            }
+            if (c != '/') {
+                out += c;
+                continue;
+            }
+        }
+        size_t n = out.size() - seg;
+        if (n == 1 && out[seg] == '.') {
+            out.resize(seg);
+        } else if (n == 2 && out[seg] == '.' && out[seg + 1] == '.') {
+            if (seg == 1) {
+                return PATH_TRAVERSAL;
+            }
+            seg = out.rfind('/', seg - 2) + 1;
+            out.resize(seg);
+        } else if (n > 0 && !end) {
+            out += '/';
+            seg = out.size();
+        }
+        if (end) {
+            return PATH_OK;
+        }
+    }
+}
+
+PathNormalizer::Result PathNormalizer::canonical(const std::string& raw, std::string& out) {
+    if (raw.size() > PATH_CACHE_MAX_LEN) {
+        return normalize(raw, out);
+    }
+    // FNV-1a
+    unsigned int hash = 2166136261u;
+    for (size_t i = 0; i < raw.size(); ++i) {
+        hash = (hash ^ static_cast<unsigned char>(raw[i])) * 16777619u;
+    }
+    Entry& entry = _cache[hash % PATH_CACHE_SIZE];
+    if (entry.used && entry.raw == raw) {
+        out = entry.canonical;
+        return entry.result;
+    }
+    entry.result = normalize(raw, entry.canonical);
+    entry.raw = raw;
+    entry.used = true;
+    out = entry.canonical;
+    return entry.result;
+}
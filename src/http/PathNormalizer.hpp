@@ -0,0 +1,44 @@
+#ifndef PATHNORMALIZER_HPP
+#define PATHNORMALIZER_HPP
+
+#include <string>
+#include <cstddef>
+
+#define PATH_CACHE_SIZE 256         // Entrées du cache (correspondance directe)
+#define PATH_CACHE_MAX_LEN 512      // Chemins plus longs : normalisés sans être mis en cache
+
+// Forme canonique d'un chemin de requête (sans query string), en un seul passage :
+// %XX décodés, "//" fusionnés, segments "." et ".." résolus. Le routage, les caches
+// et les logs utilisent tous cette forme. Un ".." qui remonterait au-dessus de la
+// racine est refusé. Un chemin sans '%', "//" ni "/." est repéré par ByteScan et
+// recopié tel quel.
+// Un normaliseur par boucle d'événements : le cache n'est pas partagé entre threads.
+class PathNormalizer {
+public:
+    enum Result {
+        PATH_OK,
+        PATH_INVALID,       // Échappement mal formé ou %00
+        PATH_TRAVERSAL      // ".." au-dessus de la racine
+    };
+
+private:
+    struct Entry {
+        std::string raw;
+        std::string canonical;
+        Result result;
+        bool used;
+
+        Entry() : result(PATH_OK), used(false) {}
+    };
+
+    Entry _cache[PATH_CACHE_SIZE];
+
+    static bool isCanonical(const char* path, size_t len);
+
+public:
+    // raw doit commencer par '/'
+    static Result normalize(const std::string& raw, std::string& out);
+    Result canonical(const std::string& raw, std::string& out); // Avec le cache
+};
+
+#endif
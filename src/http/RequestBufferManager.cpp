@@ -1,192 +1,135 @@
 #include "RequestBufferManager.hpp"
-#include <cstdlib>
-#include <cstdio>
-#include <iostream>
+#include "MultipartUpload.hpp"
 
 RequestBufferManager::RequestBufferManager() {}
 
-RequestBufferManager::~RequestBufferManager() {}
+RequestBufferManager::~RequestBufferManager() {
+    for (size_t i = 0; i < _buffers.size(); ++i) {
+        delete _buffers[i];
+    }
+}
 
-void RequestBufferManager::append(int client_fd, const std::string& data) {
-    std::string& buffer = _buffers[client_fd];
-    // More conservative memory reservation to reduce memset overhead
-    if (buffer.capacity() < buffer.size() + data.size() + 1024) {
-        buffer.reserve(buffer.size() + data.size() + 16384); // Reserve extra 16KB instead of 64KB
+RequestBufferManager::ClientBuffer& RequestBufferManager::client(int client_fd) {
+    if (static_cast<size_t>(client_fd) >= _buffers.size()) {
+        _buffers.resize(client_fd + 1, NULL);
     }
-    buffer += data;
-    // Invalidate cache when new data arrives
-    invalidateCache(client_fd);
+    if (!_buffers[client_fd]) {
+        _buffers[client_fd] = new ClientBuffer(&_pool);
+    }
+    return *_buffers[client_fd];
 }
 
-std::string RequestBufferManager::get(int client_fd) {
-    std::map<int, std::string>::iterator it = _buffers.find(client_fd);
-    if (it != _buffers.end()) {
-        return it->second;
+RequestBufferManager::ClientBuffer* RequestBufferManager::find(int client_fd) const {
+    if (client_fd < 0 || static_cast<size_t>(client_fd) >= _buffers.size()) {
+        return NULL;
     }
-    return "";
+    return _buffers[client_fd];
 }
 
-void RequestBufferManager::append(int fd, const char* data, size_t len) {
-    std::string& buffer = _buffers[fd];
-    // More conservative memory reservation to reduce memset overhead
-    if (buffer.capacity() < buffer.size() + len + 1024) {
-        buffer.reserve(buffer.size() + len + 16384); // Reserve extra 16KB instead of 64KB
+// Petit bloc rempli : la tête continue sans doute, la suite est lue tout de suite dans un
+// bloc entier (comme nginx quand il passe à un grand tampon), pas au prochain epoll_wait
+ssize_t RequestBufferManager::readFrom(int client_fd) {
+    ClientBuffer& buffer = client(client_fd);
+    size_t window = buffer.parser.readWindow(buffer.chain);
+    ssize_t bytes = buffer.chain.readFrom(client_fd, window);
+    if (bytes > 0 && static_cast<size_t>(bytes) == window && buffer.chain.isSmall()) {
+        ssize_t more = buffer.chain.readFrom(client_fd, buffer.parser.readWindow(buffer.chain));
+        if (more > 0) {
+            bytes += more;
+        }
     }
-    buffer.append(data, len);
-    // Invalidate cache when new data arrives
-    invalidateCache(fd);
+    return bytes;
 }
 
-void RequestBufferManager::clear(int client_fd) {
-    _buffers.erase(client_fd);
-    _parseCache.erase(client_fd);
+void RequestBufferManager::setSmallBufferSize(size_t size) {
+    _pool.setSmallSize(size);
 }
 
-bool RequestBufferManager::isRequestComplete(int client_fd) {
-    std::map<int, std::string>::iterator it = _buffers.find(client_fd);
-    if (it == _buffers.end()) {
-        return false;
-    }
-    
-    const std::string& buffer = it->second;
-    RequestParseCache& cache = _parseCache[client_fd];
-    
-    // If already marked complete, return immediately
-    if (cache.isComplete) {
-        return true;
-    }
-    
-    // If buffer hasn't grown since last parse and we already parsed, return cached result
-    if (buffer.length() == cache.lastParsedSize && cache.lastParsedSize > 0) {
-        return cache.isComplete;
-    }
-    
-    // Update last parsed size
-    cache.lastParsedSize = buffer.length();
-    
-    // Check headers only if not already complete
-    if (!cache.headersComplete) {
-        cache.headersComplete = hasCompleteHeaders(buffer);
-        if (!cache.headersComplete) {
-            return false;
-        }
-        
-        // Parse encoding type and content length only once
-        cache.isChunked = isChunkedEncoding(buffer);
-        if (!cache.isChunked) {
-            cache.contentLength = getContentLength(buffer);
-        }
-    }
-    
-    // Check completion based on encoding type
-    if (cache.isChunked) {
-        cache.isComplete = isChunkedComplete(buffer);
-    } else {
-        // Content-Length based completion
-        size_t headerEnd = buffer.find("\r\n\r\n");
-        if (headerEnd == std::string::npos) {
-            return false;
-        }
-        
-        size_t bodyStart = headerEnd + 4;
-        size_t currentBodyLength = (buffer.length() > bodyStart) ? buffer.length() - bodyStart : 0;
-        
-        // If no Content-Length, consider complete after headers
-        if (cache.contentLength == 0) {
-            cache.isComplete = true;
-        } else {
-            cache.isComplete = currentBodyLength >= cache.contentLength;
-        }
+void RequestBufferManager::append(int client_fd, const std::string& data) {
+    append(client_fd, data.data(), data.size());
+}
+
+void RequestBufferManager::append(int fd, const char* data, size_t len) {
+    client(fd).chain.append(data, len);
+}
+
+void RequestBufferManager::clear(int client_fd) {
+    ClientBuffer* buffer = find(client_fd);
+    if (buffer) {
+        delete buffer; // Blocs rendus au pool
+        _buffers[client_fd] = NULL;
     }
-    
-    return cache.isComplete;
 }
 
-size_t RequestBufferManager::getBufferSize(int client_fd) {
-    std::map<int, std::string>::iterator it = _buffers.find(client_fd);
-    if (it != _buffers.end()) {
-        return it->second.length();
+HttpRequestParser::Status RequestBufferManager::advance(int client_fd) {
+    ClientBuffer* buffer = find(client_fd);
+    if (!buffer) {
+        return HttpRequestParser::PARSE_INCOMPLETE;
     }
-    return 0;
+    return buffer->parser.advance(buffer->chain);
 }
 
-bool RequestBufferManager::hasCompleteHeaders(const std::string& buffer) {
-    return buffer.find("\r\n\r\n") != std::string::npos;
+// Sans buffer (fd inconnu ou déjà vidé) : une requête vide, rien n'est créé
+const HttpRequest& RequestBufferManager::pendingRequest(int client_fd) {
+    static const HttpRequest none;
+    ClientBuffer* buffer = find(client_fd);
+    return buffer ? buffer->parser.getRequest() : none;
 }
 
-size_t RequestBufferManager::getContentLength(const std::string& buffer) {
-    size_t pos = buffer.find("Content-Length:");
-    if (pos == std::string::npos) {
-        pos = buffer.find("content-length:");
-    }
-    if (pos == std::string::npos) {
-        return 0;
-    }
-    
-    pos += 15; // longueur de "Content-Length:"
-    size_t end = buffer.find("\r\n", pos);
-    if (end == std::string::npos) {
-        return 0;
-    }
-    
-    std::string lengthStr = buffer.substr(pos, end - pos);
-    // Supprimer les espaces
-    lengthStr.erase(0, lengthStr.find_first_not_of(" \t"));
-    lengthStr.erase(lengthStr.find_last_not_of(" \t") + 1);
-    
-    // Use strtoul for proper size_t parsing instead of atoi
-    char* endptr;
-    unsigned long result = strtoul(lengthStr.c_str(), &endptr, 10);
-    
-    // Check for parsing errors
-    if (*endptr != '\0' || lengthStr.empty()) {
-        return 0; // Invalid number
+// Les réglages du corps ne valent que pour une tête en cours : sans buffer, ignorés
+void RequestBufferManager::setBodyLimit(int client_fd, size_t limit) {
+    ClientBuffer* buffer = find(client_fd);
+    if (buffer) {
+        buffer->parser.setBodyLimit(limit);
     }
-    
-    return static_cast<size_t>(result);
 }
 
-bool RequestBufferManager::isChunkedEncoding(const std::string& buffer) {
-    size_t pos = buffer.find("Transfer-Encoding:");
-    if (pos == std::string::npos) {
-        pos = buffer.find("transfer-encoding:");
+void RequestBufferManager::setBodyBufferSize(int client_fd, size_t size) {
+    ClientBuffer* buffer = find(client_fd);
+    if (buffer) {
+        buffer->parser.setBodyBufferSize(size);
     }
-    if (pos == std::string::npos) {
-        return false;
+}
+
+void RequestBufferManager::setUpload(int client_fd, MultipartUpload* upload) {
+    ClientBuffer* buffer = find(client_fd);
+    if (buffer) {
+        buffer->parser.setUpload(upload);
+    } else {
+        delete upload;
     }
-    
-    size_t end = buffer.find("\r\n", pos);
-    if (end == std::string::npos) {
+}
+
+void RequestBufferManager::setHeaderLimits(int client_fd, size_t bufferSize, size_t largeBuffers, size_t largeBufferSize) {
+    client(client_fd).parser.setHeaderLimits(bufferSize, largeBuffers, largeBufferSize);
+}
+
+bool RequestBufferManager::isReadingBody(int client_fd) {
+    ClientBuffer* buffer = find(client_fd);
+    if (!buffer) {
         return false;
     }
-    
-    std::string encoding = buffer.substr(pos, end - pos);
-    return encoding.find("chunked") != std::string::npos;
+    HttpRequestParser::State state = buffer->parser.getState();
+    return state != HttpRequestParser::REQUEST_LINE && state != HttpRequestParser::HEADERS
+        && state != HttpRequestParser::COMPLETE && state != HttpRequestParser::FAILED;
 }
 
-bool RequestBufferManager::isChunkedComplete(const std::string& buffer) {
-    // Optimize: Only search the last 10 bytes for chunk terminator
-    // since "0\r\n\r\n" is only 5 bytes long
-    if (buffer.length() < 5) {
+int RequestBufferManager::getErrorStatus(int client_fd) {
+    ClientBuffer* buffer = find(client_fd);
+    return buffer ? buffer->parser.getErrorStatus() : 0;
+}
+
+// Requêtes pipelinées : les octets suivants restent dans la chaîne pour le prochain parsing
+bool RequestBufferManager::extractRequest(int client_fd, HttpRequest& request) {
+    ClientBuffer* buffer = find(client_fd);
+    if (!buffer || buffer->parser.advance(buffer->chain) != HttpRequestParser::PARSE_COMPLETE) {
         return false;
     }
-    
-    size_t searchStart = (buffer.length() > 20) ? buffer.length() - 20 : 0;
-    size_t pos = buffer.find("0\r\n\r\n", searchStart);
-    return pos != std::string::npos;
-}
-
-void RequestBufferManager::invalidateCache(int client_fd) {
-    std::map<int, RequestParseCache>::iterator it = _parseCache.find(client_fd);
-    if (it != _parseCache.end()) {
-        // Only reset completion status, keep parsed headers info if still valid
-        RequestParseCache& cache = it->second;
-        if (!cache.headersComplete) {
-            // Headers not complete yet, reset everything
-            cache = RequestParseCache();
-        } else {
-            // Headers are complete, only reset completion flag
-            cache.isComplete = false;
-        }
-    }
-}
\ No newline at end of file
+    buffer->parser.take(request);
+    return true;
+}
+
+size_t RequestBufferManager::getBufferSize(int client_fd) {
+    ClientBuffer* buffer = find(client_fd);
+    return buffer ? buffer->chain.size() + buffer->parser.getBufferedSize() : 0;
+}
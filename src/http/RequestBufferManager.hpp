@@ -1,43 +1,52 @@
 #ifndef REQUESTBUFFERMANAGER_HPP
 #define REQUESTBUFFERMANAGER_HPP
 
-#include <map>
+#include <vector>
 #include <string>
+#include <sys/types.h>
+#include "BufferChain.hpp"
+#include "HttpRequest.hpp"
 
-// Cache structure to avoid redundant parsing
-struct RequestParseCache {
-    bool headersComplete;
-    bool isChunked;
-    size_t contentLength;
-    bool isComplete;
-    size_t lastParsedSize;
-    
-    RequestParseCache() : headersComplete(false), isChunked(false), 
-                         contentLength(0), isComplete(false), lastParsedSize(0) {}
-};
-
+// Requêtes partielles par client, stockées en chaînes de blocs issus d'un pool propre à la boucle.
+// Chaque chaîne a son analyseur incrémental : les octets ne sont examinés qu'à leur arrivée.
+// Table indexée par fd, comme les FdContext : un accès par appel, sans recherche.
 class RequestBufferManager {
 private:
-    std::map<int, std::string> _buffers;
-    std::map<int, RequestParseCache> _parseCache;
+    struct ClientBuffer {
+        BufferChain chain;
+        HttpRequestParser parser;
+
+        explicit ClientBuffer(BufferPool* pool) : chain(pool) {}
+    };
+
+    BufferPool _pool;
+    std::vector<ClientBuffer*> _buffers;
+    
+    RequestBufferManager(const RequestBufferManager&);
+    RequestBufferManager& operator=(const RequestBufferManager&);
+    
+    ClientBuffer& client(int client_fd); // Crée le buffer au besoin (lecture, ajout, limites)
+    ClientBuffer* find(int client_fd) const; // NULL si le fd n'a pas de buffer
     
 public:
     RequestBufferManager();
     ~RequestBufferManager();
     
+    ssize_t readFrom(int client_fd); // Lit le socket directement dans la chaîne du client (fenêtre réduite pendant la tête)
     void append(int client_fd, const std::string& data);
     void append(int fd, const char* data, size_t len);
-    std::string get(int client_fd);
+    HttpRequestParser::Status advance(int client_fd); // Reprend l'analyse là où elle s'était arrêtée
+    const HttpRequest& pendingRequest(int client_fd); // Tête de la requête en cours (après PARSE_HEAD_READY)
+    void setBodyLimit(int client_fd, size_t limit);
+    void setBodyBufferSize(int client_fd, size_t size);
+    void setUpload(int client_fd, MultipartUpload* upload);
+    void setSmallBufferSize(size_t size); // Petits blocs de tête : le plus grand client_header_buffer_size
+    void setHeaderLimits(int client_fd, size_t bufferSize, size_t largeBuffers, size_t largeBufferSize);
+    int getErrorStatus(int client_fd);
+    bool isReadingBody(int client_fd); // Tête reçue, corps en cours de réception
+    bool extractRequest(int client_fd, HttpRequest& request); // Retire la première requête complète du buffer
     void clear(int client_fd);
-    bool isRequestComplete(int client_fd);
-    size_t getBufferSize(int client_fd);
-    
-private:
-    bool hasCompleteHeaders(const std::string& buffer);
-    size_t getContentLength(const std::string& buffer);
-    bool isChunkedEncoding(const std::string& buffer);
-    bool isChunkedComplete(const std::string& buffer);
-    void invalidateCache(int client_fd);
+    size_t getBufferSize(int client_fd); // Octets non lus + requête en cours (tête et corps déjà décodés)
 };
 
 #endif
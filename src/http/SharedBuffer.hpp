@@ -0,0 +1,28 @@
+#ifndef SHAREDBUFFER_HPP
+#define SHAREDBUFFER_HPP
+
+#include <string>
+#include <cstddef>
+
+// Octets partagés sans copie entre un cache et les réponses en cours d'envoi, libérés au
+// dernier release(). Compteur non atomique : un buffer ne quitte pas sa boucle epoll.
+struct SharedBuffer {
+    std::string data;
+
+    SharedBuffer() : _refs(1) {}
+    SharedBuffer* retain() { ++_refs; return this; }
+    void release() {
+        if (--_refs == 0) {
+            delete this;
+        }
+    }
+
+private:
+    size_t _refs;
+
+    ~SharedBuffer() {}
+    SharedBuffer(const SharedBuffer&);
+    SharedBuffer& operator=(const SharedBuffer&);
+};
+
+#endif
@@ -0,0 +1,246 @@
+#include "StaticFileCache.hpp"
+#include "HttpValidators.hpp"
+#include <cerrno>
+#include <sstream>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/inotify.h>
+
+#define FILE_CACHE_WATCH_MASK (IN_MODIFY | IN_ATTRIB | IN_CLOSE_WRITE | IN_MOVED_FROM | IN_MOVED_TO \
+                               | IN_DELETE | IN_DELETE_SELF | IN_MOVE_SELF)
+
+StaticFileCache::StaticFileCache() : _budget(0), _maxFileSize(0), _validSeconds(0), _inotifyFd(-1) {}
+
+StaticFileCache::~StaticFileCache() {
+    for (std::list<Entry*>::iterator it = _lru.begin(); it != _lru.end(); ++it) {
+        (*it)->response.buffer->release();
+        delete *it;
+    }
+    if (_inotifyFd != -1) {
+        close(_inotifyFd);
+    }
+}
+
+void StaticFileCache::configure(size_t budget, size_t maxFileSize, int validSeconds) {
+    _budget = budget;
+    _maxFileSize = (maxFileSize < budget) ? maxFileSize : budget;
+    _validSeconds = validSeconds;
+    if (_budget > 0 && _inotifyFd == -1) {
+        _inotifyFd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC); // -1 : revalidation par stat seule
+    }
+}
+
+static bool sameFile(const struct stat& st, ino_t ino, const struct timespec& mtime, size_t size) {
+    return st.st_ino == ino && st.st_mtim.tv_sec == mtime.tv_sec && st.st_mtim.tv_nsec == mtime.tv_nsec
+        && static_cast<size_t>(st.st_size) == size;
+}
+
+// Sans événement inotify, une entrée reste valide _validSeconds ; ensuite un stat la confirme
+bool StaticFileCache::isFresh(Entry* entry, time_t now) {
+    if (now - entry->validatedAt < _validSeconds) {
+        return true;
+    }
+    struct stat st;
+    if (stat(entry->path.c_str(), &st) == -1 || !sameFile(st, entry->ino, entry->mtime, entry->response.bodySize())) {
+        return false;
+    }
+    entry->validatedAt = now;
+    return true;
+}
+
+const CachedResponse* StaticFileCache::get(const std::string& path) {
+    if (_budget == 0) {
+        return NULL;
+    }
+    std::map<std::string, Entry*>::iterator it = _entries.find(path);
+    if (it == _entries.end()) {
+        ++_stats.misses;
+        return NULL;
+    }
+    Entry* entry = it->second;
+    if (!isFresh(entry, time(NULL))) {
+        ++_stats.invalidations;
+        ++_stats.misses;
+        remove(entry);
+        return NULL;
+    }
+    _lru.splice(_lru.begin(), _lru, entry->lru);
+    ++_stats.hits;
+    return &entry->response;
+}
+
+const CachedResponse* StaticFileCache::insert(const std::string& path, int fd, const struct stat& st,
+                                              const std::string& contentType) {
+    size_t size = static_cast<size_t>(st.st_size);
+    if (_budget == 0 || !S_ISREG(st.st_mode) || size > _maxFileSize) {
+        return NULL;
+    }
+    std::map<std::string, Entry*>::iterator it = _entries.find(path);
+    if (it != _entries.end()) {
+        remove(it->second);
+    }
+
+    // En-têtes fixes puis corps lu directement à sa place, sans copie intermédiaire
+    std::string etag = fileETag(st);
+    std::ostringstream headers;
+    headers << "Server: Webserv/1.0\r\n";
+    headers << "Content-Type: " << contentType << "\r\n";
+    headers << "Content-Length: " << size << "\r\n";
+    headers << "Accept-Ranges: bytes\r\n";
+    headers << "ETag: " << etag << "\r\n";
+    headers << "Last-Modified: " << httpDate(st.st_mtime) << "\r\n";
+    headers << "\r\n";
+    SharedBuffer* buffer = new SharedBuffer();
+    buffer->data = headers.str();
+    size_t headerSize = buffer->data.size();
+    buffer->data.resize(headerSize + size);
+    size_t done = 0;
+    while (done < size) {
+        ssize_t n = pread(fd, &buffer->data[headerSize + done], size - done, done);
+        if (n <= 0) {
+            if (n == -1 && errno == EINTR) {
+                continue;
+            }
+            buffer->release(); // Fichier tronqué pendant la lecture : servi depuis le disque
+            return NULL;
+        }
+        done += n;
+    }
+
+    Entry* entry = new Entry();
+    entry->path = path;
+    size_t slash = path.rfind('/');
+    entry->dir = (slash == std::string::npos) ? "." : (slash == 0 ? "/" : path.substr(0, slash));
+    entry->response.buffer = buffer;
+    entry->response.headerSize = headerSize;
+    entry->response.lastModified = st.st_mtime;
+    entry->response.etag = etag;
+    entry->mtime = st.st_mtim;
+    entry->ino = st.st_ino;
+    entry->validatedAt = time(NULL);
+
+    // Libérer la place par la fin de la liste LRU
+    while (_stats.bytes + buffer->data.size() > _budget && !_lru.empty()) {
+        ++_stats.evictions;
+        remove(_lru.back());
+    }
+    _lru.push_front(entry);
+    entry->lru = _lru.begin();
+    _entries[path] = entry;
+    _stats.bytes += buffer->data.size();
+    ++_stats.entries;
+    watch(entry);
+    return &entry->response;
+}
+
+const CachedResponse* StaticFileCache::load(const std::string& path, const std::string& contentType) {
+    const CachedResponse* cached = get(path);
+    if (cached || _budget == 0) {
+        return cached;
+    }
+    int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd == -1) {
+        return NULL;
+    }
+    struct stat st;
+    if (fstat(fd, &st) == 0) {
+        cached = insert(path, fd, st, contentType);
+    }
+    close(fd);
+    return cached;
+}
+
+// Un watch par répertoire, partagé par ses entrées
+void StaticFileCache::watch(Entry* entry) {
+    if (_inotifyFd == -1) {
+        return;
+    }
+    std::map<std::string, DirWatch>::iterator it = _dirs.find(entry->dir);
+    if (it != _dirs.end()) {
+        ++it->second.refs;
+        return;
+    }
+    int wd = inotify_add_watch(_inotifyFd, entry->dir.c_str(), FILE_CACHE_WATCH_MASK);
+    if (wd == -1) {
+        return; // Limite de watches atteinte : revalidation par stat pour ce répertoire
+    }
+    DirWatch dirWatch;
+    dirWatch.wd = wd;
+    dirWatch.refs = 1;
+    _dirs[entry->dir] = dirWatch;
+    _watchDirs[wd] = entry->dir;
+}
+
+void StaticFileCache::remove(Entry* entry) {
+    std::map<std::string, DirWatch>::iterator it = _dirs.find(entry->dir);
+    if (it != _dirs.end() && --it->second.refs == 0) {
+        inotify_rm_watch(_inotifyFd, it->second.wd);
+        _watchDirs.erase(it->second.wd);
+        _dirs.erase(it);
+    }
+    // Une réponse en cours d'envoi garde sa référence sur le buffer
+    _stats.bytes -= entry->response.buffer->data.size();
+    entry->response.buffer->release();
+    --_stats.entries;
+    _lru.erase(entry->lru);
+    _entries.erase(entry->path);
+    delete entry;
+}
+
+void StaticFileCache::invalidate(const std::string& path) {
+    std::map<std::string, Entry*>::iterator it = _entries.find(path);
+    if (it != _entries.end()) {
+        ++_stats.invalidations;
+        remove(it->second);
+    }
+}
+
+// Répertoire supprimé ou déplacé : toutes ses entrées partent, le watch est déjà retiré
+void StaticFileCache::removeDir(const std::string& dir) {
+    std::map<std::string, DirWatch>::iterator watchIt = _dirs.find(dir);
+    if (watchIt != _dirs.end()) {
+        _watchDirs.erase(watchIt->second.wd);
+        _dirs.erase(watchIt);
+    }
+    std::list<Entry*>::iterator it = _lru.begin();
+    while (it != _lru.end()) {
+        Entry* entry = *it++;
+        if (entry->dir == dir) {
+            ++_stats.invalidations;
+            remove(entry);
+        }
+    }
+}
+
+void StaticFileCache::handleEvents() {
+    char buffer[4096] __attribute__((aligned(__alignof__(struct inotify_event))));
+    while (true) {
+        ssize_t len = read(_inotifyFd, buffer, sizeof(buffer));
+        if (len <= 0) {
+            return; // EAGAIN : file vidée
+        }
+        for (char* p = buffer; p < buffer + len; ) {
+            struct inotify_event* event = reinterpret_cast<struct inotify_event*>(p);
+            p += sizeof(struct inotify_event) + event->len;
+            if (event->mask & IN_Q_OVERFLOW) {
+                // Événements perdus : on ne sait plus ce qui a changé
+                while (!_lru.empty()) {
+                    ++_stats.invalidations;
+                    remove(_lru.back());
+                }
+                continue;
+            }
+            std::map<int, std::string>::iterator dirIt = _watchDirs.find(event->wd);
+            if (dirIt == _watchDirs.end()) {
+                continue;
+            }
+            if (event->mask & (IN_DELETE_SELF | IN_MOVE_SELF | IN_IGNORED)) {
+                std::string dir = dirIt->second;
+                removeDir(dir);
+            } else if (event->len > 0) {
+                std::string dir = dirIt->second;
+                invalidate((dir == "/") ? "/" + std::string(event->name) : dir + "/" + event->name);
+            }
+        }
+    }
+}
@@ -0,0 +1,98 @@
+#ifndef STATICFILECACHE_HPP
+#define STATICFILECACHE_HPP
+
+#include <string>
+#include <map>
+#include <list>
+#include <ctime>
+#include <sys/stat.h>
+#include "SharedBuffer.hpp"
+
+// Réponse 200 sérialisée une fois : les en-têtes fixes (ni ligne de statut, ni Date, ni
+// Connection, propres à chaque envoi) suivis du corps, dans un seul buffer partagé. Une
+// page d'erreur n'en reprend que le corps (à partir de headerSize)
+struct CachedResponse {
+    SharedBuffer* buffer;
+    size_t headerSize;
+    time_t lastModified;    // Validateurs du fichier mis en cache (requêtes conditionnelles)
+    std::string etag;
+
+    size_t bodySize() const { return buffer->data.size() - headerSize; }
+    std::string body() const { return buffer->data.substr(headerSize); }
+};
+
+// Réponses des petits fichiers statiques servis souvent (pages, scripts, styles, pages
+// d'erreur), indexées par chemin résolu. Un cache par boucle d'événements : pas de verrou,
+// le budget mémoire s'entend par worker. Éviction LRU au-delà du budget.
+// Invalidation : inotify sur les répertoires des fichiers en cache (un événement sur le
+// fichier le retire) ; en plus, une entrée plus vieille que l'intervalle de validité est
+// revérifiée par stat (inotify indisponible, débordement de sa file...).
+class StaticFileCache {
+public:
+    struct Stats {
+        size_t hits;
+        size_t misses;
+        size_t evictions;       // Retirés pour tenir le budget
+        size_t invalidations;   // Retirés car modifiés sur disque
+        size_t entries;
+        size_t bytes;
+
+        Stats() : hits(0), misses(0), evictions(0), invalidations(0), entries(0), bytes(0) {}
+    };
+
+private:
+    struct Entry {
+        std::string path;
+        std::string dir;
+        CachedResponse response;
+        struct timespec mtime;
+        ino_t ino;
+        time_t validatedAt;
+        std::list<Entry*>::iterator lru;
+    };
+
+    struct DirWatch {
+        int wd;
+        size_t refs;    // Entrées du cache dans ce répertoire
+    };
+
+    size_t _budget;         // 0 : cache désactivé
+    size_t _maxFileSize;
+    int _validSeconds;
+    std::map<std::string, Entry*> _entries;
+    std::list<Entry*> _lru;                 // Plus récent en tête
+    int _inotifyFd;
+    std::map<std::string, DirWatch> _dirs;
+    std::map<int, std::string> _watchDirs;  // wd -> répertoire
+    Stats _stats;
+
+    StaticFileCache(const StaticFileCache&);
+    StaticFileCache& operator=(const StaticFileCache&);
+
+    bool isFresh(Entry* entry, time_t now);
+    void watch(Entry* entry);
+    void remove(Entry* entry);
+    void removeDir(const std::string& dir);
+    void invalidate(const std::string& path);
+
+public:
+    StaticFileCache();
+    ~StaticFileCache();
+
+    // Crée le fd inotify (non bloquant) ; budget 0 : tout passe au disque
+    void configure(size_t budget, size_t maxFileSize, int validSeconds);
+    int inotifyFd() const { return _inotifyFd; }
+    void handleEvents();    // fd inotify lisible : retirer les fichiers modifiés
+
+    // Réponse à jour pour path, NULL s'il n'est pas en cache. Valide jusqu'au prochain
+    // appel : retain() sur buffer pour la garder au-delà
+    const CachedResponse* get(const std::string& path);
+    // Met en cache le fichier ouvert fd (st : son fstat) s'il est assez petit ; NULL sinon
+    const CachedResponse* insert(const std::string& path, int fd, const struct stat& st, const std::string& contentType);
+    // get, sinon ouverture et insert ; NULL si absent ou non cacheable
+    const CachedResponse* load(const std::string& path, const std::string& contentType);
+
+    const Stats& stats() const { return _stats; }
+};
+
+#endif
@@ -1,6 +1,10 @@
 #include "core/EpollClasse.hpp"
+#include "core/WorkerPool.hpp"
+#include "core/ProcessControl.hpp"
 #include "config/Parser.hpp"
 #include "serverConfig/ServerConfig.hpp"
+#include "http/ByteScan.hpp"
+#include "utils/Logger.hpp"
 #include <vector>
 #include <iostream>
 
@@ -35,10 +39,15 @@ int main(int argc, char **argv)
             }
         }
 
-        // Initialiser et exécuter EpollClasse
-        EpollClasse epollServer;
-        epollServer.setupServers(serverConfigs, servers);
-        epollServer.serverRun();
+        // Noyau de recherche d'octets mesuré sur cette machine, avant les workers
+        Logger::logMsg(GREEN, CONSOLE_OUTPUT, "Byte scan kernel: %s", ByteScan::calibrate());
+
+        // Signaux d'arrêt gracieux / mise à jour, sockets hérités d'une mise à jour
+        ProcessControl::init(argc, argv);
+
+        // Initialiser et exécuter une boucle EpollClasse par worker
+        WorkerPool workers(serverConfigs, servers, parser.getGlobalConfig());
+        workers.run();
     }
     catch (const std::exception& e) {
         std::cerr << "Erreur : " << e.what() << std::endl;
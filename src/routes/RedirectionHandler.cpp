@@ -14,5 +14,6 @@ std::string RedirectionHandler::generateRedirectReponse(int statusCode, const st
 {
     std::string statusMessage = (statusCode == 301) ? "Moved Permanently" : "Found";
     return "HTTP/1.1 " + to_string(statusCode) + " " + statusMessage + "\r\n"
-           "Location: " + url + "\r\n\r\n";
+           "Location: " + url + "\r\n"
+           "Content-Length: 0\r\n\r\n"; // Sans corps : indispensable en keep-alive
 }
\ No newline at end of file
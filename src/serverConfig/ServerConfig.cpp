@@ -5,7 +5,7 @@
 #include <stdexcept> // Pour std::runtime_error
 
 ServerConfig::ServerConfig(const std::string &host, int port)
-    : _host(host), _port(port), _server_fd(-1)
+    : _host(host), _port(port), _server_fd(-1), _reusePort(false)
 {
     memset(&_address, 0, sizeof(_address));
     _address.sin_family = AF_INET;
@@ -32,13 +32,23 @@ ServerConfig::~ServerConfig()
     }
 }
 
-void ServerConfig::setupServer()
+void ServerConfig::setupServer(int inheritedFd)
 {
     // Fermer le socket s'il était déjà ouvert
     if (_server_fd != -1)
     {   close(_server_fd); }
 
-    _server_fd = socket(AF_INET, SOCK_STREAM, 0);
+    // Socket transmis par le processus précédent (SIGUSR2) : déjà lié et en écoute
+    if (inheritedFd != -1)
+    {
+        _server_fd = inheritedFd;
+        fcntl(_server_fd, F_SETFL, fcntl(_server_fd, F_GETFL, 0) | O_NONBLOCK);
+        Logger::logMsg(GREEN, CONSOLE_OUTPUT, "Server listening on %s:%d (inherited fd %d)", _host.c_str(), _port, _server_fd);
+        return;
+    }
+
+    // Fermé à l'exec : les CGI n'héritent pas des sockets d'écoute
+    _server_fd = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
     if (_server_fd == -1)
     {
         Logger::logMsg(RED, CONSOLE_OUTPUT, "Socket creation failed");
@@ -54,6 +64,14 @@ void ServerConfig::setupServer()
         throw std::runtime_error("Setsockopt failed");
     }
 
+    // Plusieurs workers écoutent sur le même port : le noyau répartit les connexions
+    if (_reusePort && setsockopt(_server_fd, SOL_SOCKET, SO_REUSEPORT, &opt, sizeof(opt)) == -1)
+    {
+        Logger::logMsg(RED, CONSOLE_OUTPUT, "Setsockopt SO_REUSEPORT failed");
+        close(_server_fd);
+        throw std::runtime_error("Setsockopt SO_REUSEPORT failed");
+    }
+
     // Désactiver l'algorithme de Nagle pour réduire la latence
     if (setsockopt(_server_fd, IPPROTO_TCP, TCP_NODELAY, &opt, sizeof(opt)) == -1)
     {
@@ -106,6 +124,16 @@ void ServerConfig::setupServer()
     Logger::logMsg(GREEN, CONSOLE_OUTPUT, "Server listening on %s:%d", _host.c_str(), _port);
 }
 
+// Arrêt gracieux : ne plus accepter sur ce socket
+void ServerConfig::closeSocket()
+{
+    if (_server_fd != -1)
+    {
+        close(_server_fd);
+        _server_fd = -1;
+    }
+}
+
 int ServerConfig::getFd() const
 {
     return _server_fd;
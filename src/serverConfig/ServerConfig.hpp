@@ -16,7 +16,9 @@ public:
     ServerConfig(const std::string &host, int port);
     ~ServerConfig();
 
-    void setupServer();
+    void setupServer(int inheritedFd = -1); // inheritedFd : socket déjà en écoute, repris tel quel
+    void closeSocket();
+    void setReusePort(bool enable) { _reusePort = enable; } // Un socket d'écoute par worker (SO_REUSEPORT)
     int getFd() const;
     std::string getServerName() const;
     
@@ -28,6 +30,7 @@ private:
     std::string _host;
     int _port;
     int _server_fd; // Ajout du membre manquant
+    bool _reusePort;
     struct sockaddr_in _address;
 };
 
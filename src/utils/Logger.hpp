@@ -21,10 +21,10 @@ public:
         va_start(args, format);
         if (output == CONSOLE_OUTPUT)
         {
-            // Use std::cerr and vfprintf to avoid mixing iostream and stdio
-            std::cerr << color;
-            vfprintf(stderr, format, args);
-            std::cerr << "\033[0m" << std::endl;
+            // Formater puis écrire en un seul appel : les lignes des workers ne s'entremêlent pas
+            char message[4096];
+            vsnprintf(message, sizeof(message), format, args);
+            fprintf(stderr, "%s%s\033[0m\n", color, message);
         }
         va_end(args);
     }